@@ -2,6 +2,8 @@
 #include <modes.h>
 #include <aes.h>
 #include <filters.h>
+#include <gcm.h>
+#include <osrng.h>
 #include <stdexcept>
 #include <immintrin.h>	// _rdrand32_step
 
@@ -44,4 +46,54 @@ std::string AESWrapper::decrypt(const uint8_t* cipher, size_t length) const
 	stfDecryptor.MessageEnd();
 
 	return decrypted;
-}
\ No newline at end of file
+}
+
+// PKCS#7 always adds between 1 and BLOCKSIZE bytes of padding.
+size_t AESWrapper::cipherSize(size_t plainSize)
+{
+	return (plainSize / CryptoPP::AES::BLOCKSIZE + 1) * CryptoPP::AES::BLOCKSIZE;
+}
+
+void AESWrapper::beginEncryption()
+{
+	CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = { 0 };	// for practical use iv should never be a fixed value!
+
+	_cbcEncryption.SetKeyWithIV(_key.symetricKey, sizeof(_key.symetricKey), iv);
+	_cipherChunk.clear();
+	_encryptor.reset(new CryptoPP::StreamTransformationFilter(_cbcEncryption, new CryptoPP::StringSink(_cipherChunk)));
+}
+
+const std::string& AESWrapper::encryptChunk(const uint8_t* plain, size_t length, bool last)
+{
+	if (!_encryptor)
+		throw std::logic_error("AESWrapper: beginEncryption() was not called");
+
+	_cipherChunk.clear();			// keeps the capacity, so the chunk buffer is allocated once.
+	_encryptor->Put(plain, length);
+	if (last) {
+		_encryptor->MessageEnd();
+		_encryptor.reset();
+	}
+	return _cipherChunk;
+}
+
+// The record is encrypted with the nonce (GCM_NONCE_SIZE bytes), the cipher and its tag are written to sealed (sealedSize(length) bytes).
+// Returns the number of bytes written.
+size_t AESWrapper::seal(const uint8_t* nonce, const uint8_t* plain, size_t length, uint8_t* sealed) const
+{
+	CryptoPP::GCM<CryptoPP::AES>::Encryption gcmEncryption;
+	gcmEncryption.SetKeyWithIV(_key.symetricKey, sizeof(_key.symetricKey), nonce, GCM_NONCE_SIZE);
+
+	CryptoPP::ArraySink* sink = new CryptoPP::ArraySink(sealed, sealedSize(length));
+	CryptoPP::AuthenticatedEncryptionFilter encryptor(gcmEncryption, sink, false, GCM_TAG_SIZE);
+	encryptor.Put(plain, length);
+	encryptor.MessageEnd();
+	return static_cast<size_t>(sink->TotalPutLength());
+}
+
+// Random bytes for the nonces, a nonce is never used twice with the same key.
+void AESWrapper::randomBytes(uint8_t* bytes, size_t size)
+{
+	CryptoPP::AutoSeededRandomPool rng;
+	rng.GenerateBlock(bytes, size);
+}
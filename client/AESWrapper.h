@@ -1,7 +1,15 @@
 #pragma once
 #include <string>
+#include <memory>
+#include <modes.h>
+#include <aes.h>
+#include <filters.h>
+#include <gcm.h>
 #include "request.h"
 
+// Encryption of the transferred content: AES-CBC with fixed IV (every protocol version), or AES-GCM with a nonce for every record.
+enum class CipherMode { CBC, GCM };
+
 class AESWrapper
 {
 public:
@@ -19,6 +27,19 @@ public:
 	std::string encrypt(const uint8_t* plain, size_t length) const;
 	std::string decrypt(const uint8_t* cipher, size_t length) const;
 
+	// Streaming encryption, the plain text is passed chunk by chunk and the last chunk is padded.
+	static size_t cipherSize(size_t plainSize);
+	void beginEncryption();
+	const std::string& encryptChunk(const uint8_t* plain, size_t length, bool last);
+
+	// Authenticated encryption (AES-GCM), every record is sealed on its own, on any thread, into a buffer of the caller (buffer pool).
+	static size_t sealedSize(size_t length) { return length + GCM_TAG_SIZE; }
+	size_t seal(const uint8_t* nonce, const uint8_t* plain, size_t length, uint8_t* sealed) const;
+	static void randomBytes(uint8_t* bytes, size_t size);
+
 private:
 	SymetricKey _key;
+	CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption _cbcEncryption;
+	std::unique_ptr<CryptoPP::StreamTransformationFilter> _encryptor;
+	std::string _cipherChunk;		// Output of the last encrypted chunk, reused between chunks.
 };
\ No newline at end of file
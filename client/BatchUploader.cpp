@@ -0,0 +1,85 @@
+#include "BatchUploader.h"
+#include <iostream>
+
+BatchUploader::BatchUploader(const Client& identity, const size_t workers, ChangeIndex* change_index) : engine(workers), next_file(0), stored_files(0)
+{
+	for (size_t i = 0; i < (workers == 0 ? 1 : workers); i++) {
+		Client* session = new Client(engine);
+		session->shareIdentity(identity);
+		session->setChangeIndex(change_index);		// Sessions run on one thread, they share the index without locking.
+		sessions.push_back(session);
+	}
+}
+
+BatchUploader::~BatchUploader()
+{
+	for (auto session : sessions)
+		delete session;
+}
+
+/* The function sends all the files with the parallel sessions and returns the number of files that were stored by the server. */
+size_t BatchUploader::upload(const std::vector<std::string>& files)
+{
+	files_to_send = files;
+	next_file = 0;
+	stored_files = 0;
+
+	for (auto session : sessions) {
+		engine.spawn<bool>(runSession(*session), [](bool) {});
+	}
+	engine.run();		// Returns when all the sessions are done.
+
+	std::cout << stored_files << " of " << files_to_send.size() << " files securly sent to the server and stored." << std::endl;
+	return stored_files;
+}
+
+/* The function runs one session: connects once and sends files from the common list until no file is left. */
+awaitable<bool> BatchUploader::runSession(Client& session)
+{
+	if (next_file >= files_to_send.size())
+		co_return true;		// More sessions than files.
+
+	bool connected = co_await session.asyncBeginSession();
+	if (!connected) {
+		std::cout << "Error: Failed to connect to the server." << std::endl;
+		co_return false;
+	}
+
+	while (next_file < files_to_send.size()) {
+		const std::string filepath = files_to_send[next_file++];
+		bool stored = co_await uploadFile(session, filepath);
+		if (stored)
+			stored_files++;
+	}
+
+	session.endSession();
+	co_return true;
+}
+
+/*  The function sends one file and checks the CRC value, if CRC value invalid, the function tries to send the file 3 more times, if all
+	failed, sends final invalid crc request. Returns true if the file was stored by the server. */
+awaitable<bool> BatchUploader::uploadFile(Client& session, const std::string filepath)
+{
+	const int VALID_CRC = 1;		// Valid crc case
+	const int INVALID_CRC = 2;		// Invalid crc case
+
+	int result = co_await session.asyncSendFile(filepath);
+
+	int count = 3;
+	while (result == INVALID_CRC && count > 0) {
+		count--;
+		result = co_await session.asyncSendFile(filepath);
+	}
+
+	if (result == INVALID_CRC) {
+		std::cout << "Tried to send " << filepath << " 3 additional times without success, sending final invalid crc request" << std::endl;
+		bool finalSent = co_await session.asyncSendFinalInvalidCrcRequest(filepath);
+		if (!finalSent)
+			std::cout << "Failed to send final invalid crc request for file: " << filepath << std::endl;
+	}
+	else if (result != VALID_CRC) {
+		std::cout << "Failed to send file: " << filepath << std::endl;
+	}
+
+	co_return result == VALID_CRC;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "TransferEngine.h"
+#include "Client.h"
+
+/*  Uploads many files with a pool of parallel sessions. Every session is a Client with its own connection, all of them share the
+	registered identity and the symetric key of one client, so the key exchange (or reconnection) is done once for all the files.
+	The sessions run on one engine: the network I/O on one thread and the reading, CRC and encryption of the files on the worker threads,
+	every session takes the next file from the common list when it is done with the previous one. */
+class BatchUploader
+{
+public:
+	BatchUploader(const Client& identity, const size_t workers, ChangeIndex* change_index = nullptr);
+	virtual ~BatchUploader();
+
+	size_t upload(const std::vector<std::string>& files);
+
+private:
+	TransferEngine engine;
+	std::vector<Client*> sessions;				// One client for every worker, sharing the identity.
+	std::vector<std::string> files_to_send;		// Common list of the files, taken in order by the sessions.
+	size_t next_file;							// Next file of the list to take (sessions run on one thread, no locking needed).
+	size_t stored_files;						// Files that were sent and stored with valid CRC.
+
+	awaitable<bool> runSession(Client& session);
+	awaitable<bool> uploadFile(Client& session, const std::string filepath);
+};
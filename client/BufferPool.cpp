@@ -0,0 +1,144 @@
+#include "BufferPool.h"
+#include <cstring>
+#include <new>
+#include <utility>
+
+BufferPool::BufferPool() : allocated(0)
+{
+	for (auto& buffers : free_buffers)
+		buffers.reserve(MAX_FREE_BUFFERS);		// release() never allocates.
+}
+
+BufferPool::~BufferPool()
+{
+	for (size_t i = 0; i < SIZE_CLASSES; i++) {
+		for (uint8_t* buffer : free_buffers[i])
+			::operator delete(buffer, std::align_val_t(BUFFER_ALIGNMENT));
+	}
+}
+
+/* The function returns the pool of the process. It is never destroyed, buffers may be released by static objects at the exit. */
+BufferPool& BufferPool::shared()
+{
+	static BufferPool* pool = new BufferPool();
+	return *pool;
+}
+
+/* The function returns the size class of the buffer size, SIZE_CLASSES if it is too big for the pool. */
+size_t BufferPool::sizeClass(const size_t size)
+{
+	size_t index = 0;
+	for (size_t classSize = MIN_POOLED_BUFFER_SIZE; classSize < size; classSize <<= 1) {
+		if (++index == SIZE_CLASSES)
+			break;
+	}
+	return index;
+}
+
+/*  The function returns an aligned buffer of at least size bytes, a free buffer of the pool if there is one. capacity is set to the
+	real size of the buffer, it is passed back to release(). */
+uint8_t* BufferPool::acquire(const size_t size, size_t& capacity)
+{
+	const size_t index = sizeClass(size);
+	if (index < SIZE_CLASSES) {
+		capacity = MIN_POOLED_BUFFER_SIZE << index;
+		std::lock_guard<std::mutex> guard(lock);
+		if (!free_buffers[index].empty()) {
+			uint8_t* buffer = free_buffers[index].back();
+			free_buffers[index].pop_back();
+			return buffer;
+		}
+	}
+	else {
+		capacity = (size + BUFFER_ALIGNMENT - 1) / BUFFER_ALIGNMENT * BUFFER_ALIGNMENT;
+	}
+	allocated++;
+	return static_cast<uint8_t*>(::operator new(capacity, std::align_val_t(BUFFER_ALIGNMENT)));
+}
+
+/* The function returns the buffer to the pool, it is freed if it is too big or its size class has enough free buffers. */
+void BufferPool::release(uint8_t* const buffer, const size_t capacity)
+{
+	if (buffer == nullptr)
+		return;
+	const size_t index = sizeClass(capacity);
+	if (index < SIZE_CLASSES) {
+		std::lock_guard<std::mutex> guard(lock);
+		if (free_buffers[index].size() < MAX_FREE_BUFFERS) {
+			free_buffers[index].push_back(buffer);
+			return;
+		}
+	}
+	::operator delete(buffer, std::align_val_t(BUFFER_ALIGNMENT));
+}
+
+PooledBuffer::PooledBuffer(const size_t size) : PooledBuffer()
+{
+	resize(size);
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept : PooledBuffer()
+{
+	swap(other);
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+	if (this != &other) {
+		release();
+		swap(other);
+	}
+	return *this;
+}
+
+/* The function makes sure the buffer has capacity bytes, the content is kept. */
+void PooledBuffer::reserve(const size_t capacity)
+{
+	if (capacity <= buffer_capacity)
+		return;
+	size_t newCapacity = 0;
+	uint8_t* newBuffer = BufferPool::shared().acquire(capacity, newCapacity);
+	if (buffer_size > 0)
+		memcpy(newBuffer, buffer, buffer_size);
+	BufferPool::shared().release(buffer, buffer_capacity);
+	buffer = newBuffer;
+	buffer_capacity = newCapacity;
+}
+
+/* The function sets the size of the content, new bytes are not initialized. */
+void PooledBuffer::resize(const size_t size)
+{
+	reserve(size);
+	buffer_size = size;
+}
+
+void PooledBuffer::assign(const uint8_t* const bytes, const size_t size)
+{
+	resize(size);
+	if (size > 0)
+		memcpy(buffer, bytes, size);
+}
+
+void PooledBuffer::append(const uint8_t* const bytes, const size_t size)
+{
+	const size_t offset = buffer_size;
+	resize(buffer_size + size);
+	if (size > 0)
+		memcpy(buffer + offset, bytes, size);
+}
+
+void PooledBuffer::swap(PooledBuffer& other) noexcept
+{
+	std::swap(buffer, other.buffer);
+	std::swap(buffer_size, other.buffer_size);
+	std::swap(buffer_capacity, other.buffer_capacity);
+}
+
+/* The function returns the memory to the pool, the buffer is empty after it. */
+void PooledBuffer::release()
+{
+	BufferPool::shared().release(buffer, buffer_capacity);
+	buffer = nullptr;
+	buffer_size = 0;
+	buffer_capacity = 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+constexpr size_t BUFFER_ALIGNMENT = 64;						// Cache line, the CRC and AES kernels load whole lines.
+constexpr size_t MIN_POOLED_BUFFER_SIZE = 4 * 1024;			// Smallest size class, every buffer is a power of two from it.
+constexpr size_t MAX_POOLED_BUFFER_SIZE = 64 * 1024 * 1024;	// Bigger buffers are allocated and freed every time.
+constexpr size_t MAX_FREE_BUFFERS = 16;						// Free buffers kept in every size class, the rest are freed.
+
+/*  Pool of aligned byte buffers, shared by all the clients and the worker threads of the engine. A buffer that is released goes back to
+	the free list of its size class and the next acquire of that size takes it, so once the buffers of an upload were allocated the next
+	uploads (and the retries) run without heap allocations of the request, content and cipher buffers. */
+class BufferPool
+{
+public:
+	static BufferPool& shared();
+	~BufferPool();
+
+	uint8_t* acquire(const size_t size, size_t& capacity);
+	void release(uint8_t* const buffer, const size_t capacity);
+	size_t allocations() const { return allocated; }		// Buffers allocated from the heap so far.
+
+private:
+	static constexpr size_t SIZE_CLASSES = 15;				// 4 KB ... 64 MB
+
+	BufferPool();
+	static size_t sizeClass(const size_t size);
+
+	std::mutex lock;
+	std::array<std::vector<uint8_t*>, SIZE_CLASSES> free_buffers;
+	std::atomic<size_t> allocated;
+};
+
+/*  Growable byte buffer drawn from the buffer pool, used instead of std::vector<uint8_t> for the frames, the file content and the cipher.
+	The memory goes back to the pool when the buffer is destroyed or released. clear() keeps the memory for the next content. */
+class PooledBuffer
+{
+public:
+	PooledBuffer() : buffer(nullptr), buffer_size(0), buffer_capacity(0) {}
+	explicit PooledBuffer(const size_t size);
+	~PooledBuffer() { release(); }
+	PooledBuffer(const PooledBuffer& other) = delete;
+	PooledBuffer(PooledBuffer&& other) noexcept;
+
+	PooledBuffer& operator=(const PooledBuffer& other) = delete;
+	PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+
+	uint8_t* data() { return buffer; }
+	const uint8_t* data() const { return buffer; }
+	size_t size() const { return buffer_size; }
+	size_t capacity() const { return buffer_capacity; }
+	bool empty() const { return buffer_size == 0; }
+
+	void reserve(const size_t capacity);
+	void resize(const size_t size);
+	void clear() { buffer_size = 0; }
+	void assign(const uint8_t* const bytes, const size_t size);
+	void append(const uint8_t* const bytes, const size_t size);
+	void swap(PooledBuffer& other) noexcept;
+	void release();
+
+private:
+	uint8_t* buffer;
+	size_t buffer_size;
+	size_t buffer_capacity;
+};
@@ -0,0 +1,117 @@
+#include "ChangeIndex.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+ChangeIndex::ChangeIndex(const std::string& index_path) : index_path(index_path), changed(false)
+{
+}
+
+ChangeIndex::~ChangeIndex()
+{
+}
+
+/*  The function loads the index from the disk. The first line is the owner of the index, every next line is one file:
+	crc size mtime inode path. An index of another owner is not loaded, it is replaced on the next save.
+	Returns false if there is no index of the owner. */
+bool ChangeIndex::load(const std::string& index_owner)
+{
+	owner = index_owner;
+	entries.clear();
+	changed = false;
+
+	std::ifstream file(index_path);
+	if (!file)
+		return false;
+
+	std::string line;
+	if (!std::getline(file, line) || line != owner)
+		return false;
+
+	while (std::getline(file, line)) {
+		std::istringstream fields(line);
+		Entry entry;
+		std::string path;
+		if (!(fields >> entry.crc >> entry.state.size >> entry.state.mtime >> entry.state.inode))
+			continue;		// Damaged line, the file is sent again.
+		std::getline(fields >> std::ws, path);
+		if (!path.empty())
+			entries[path] = entry;
+	}
+	return true;
+}
+
+/*  The function writes the index to the disk, if there is anything new in it. The index is written to a temporary file first and
+	renamed, so an interrupted run does not leave a damaged index. Returns true if succseed and false otherwise. */
+bool ChangeIndex::save()
+{
+	if (!changed)
+		return true;
+
+	const std::string tempPath = index_path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::trunc);
+		if (!file) {
+			std::cout << "Error: Failed to open: " << tempPath << ", tried to save the change index." << std::endl;
+			return false;
+		}
+		file << owner << '\n';
+		for (const auto& [path, entry] : entries) {
+			file << entry.crc << ' ' << entry.state.size << ' ' << entry.state.mtime << ' ' << entry.state.inode << ' ' << path << '\n';
+		}
+		if (!file.flush()) {
+			std::cout << "Error: Failed to write the change index into " << tempPath << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code errorCode;		// without this rename() will throw exception.
+	std::filesystem::rename(tempPath, index_path, errorCode);
+	if (errorCode) {
+		std::cout << "Error: Failed to replace " << index_path << ": " << errorCode.message() << std::endl;
+		return false;
+	}
+	changed = false;
+	return true;
+}
+
+/* The function checks if the file was verified by the server in the given state, that is not changed since it was sent. */
+bool ChangeIndex::isUnchanged(const std::string& filepath, const FileState& state) const
+{
+	const auto entry = entries.find(key(filepath));
+	return entry != entries.end() && entry->second.state == state;
+}
+
+/* The function records the file as verified by the server, in the state it had before it was read. */
+void ChangeIndex::setVerified(const std::string& filepath, const FileState& state, const uint32_t crc)
+{
+	entries[key(filepath)] = Entry{ state, crc };
+	changed = true;
+}
+
+/* The function reads the current state of the file (size, last write time and inode), returns false if the file does not exist. */
+bool ChangeIndex::fileState(const std::string& filepath, FileState& state)
+{
+	std::error_code errorCode;		// without this the functions below will throw exception.
+	state.size = std::filesystem::file_size(filepath, errorCode);
+	if (errorCode)
+		return false;
+	state.mtime = static_cast<int64_t>(std::filesystem::last_write_time(filepath, errorCode).time_since_epoch().count());
+	if (errorCode)
+		return false;
+
+	struct stat fileStat;
+	state.inode = (stat(filepath.c_str(), &fileStat) == 0) ? static_cast<uint64_t>(fileStat.st_ino) : 0;
+	return true;
+}
+
+/* The function returns the key of the file in the index, the absolute path, so the same file is found from any folder. */
+std::string ChangeIndex::key(const std::string& filepath)
+{
+	std::error_code errorCode;
+	const auto absolutePath = std::filesystem::absolute(filepath, errorCode);
+	return errorCode ? filepath : absolutePath.lexically_normal().string();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+constexpr auto CHANGE_INDEX = "upload.index";
+
+/* State of a file on the disk, a file with the same state is taken as not changed. */
+struct FileState
+{
+	uint64_t size;
+	int64_t mtime;			// Last write time, in the ticks of the file system clock.
+	uint64_t inode;			// File serial number, 0 where the file system does not have one.
+
+	bool operator==(const FileState& other) const { return size == other.size && mtime == other.mtime && inode == other.inode; }
+};
+
+/*  Local index of the files that were sent and verified by the server (valid CRC), kept on the disk between runs. A file that has the
+	same state as when it was verified is not read, encrypted or sent again. The index belongs to one owner (client at a server), the
+	index of another owner is not used. */
+class ChangeIndex
+{
+public:
+	ChangeIndex(const std::string& index_path = CHANGE_INDEX);
+	virtual ~ChangeIndex();
+
+	bool load(const std::string& index_owner);
+	bool save();
+	bool isUnchanged(const std::string& filepath, const FileState& state) const;
+	void setVerified(const std::string& filepath, const FileState& state, const uint32_t crc);
+
+	static bool fileState(const std::string& filepath, FileState& state);
+
+private:
+	struct Entry
+	{
+		FileState state;
+		uint32_t crc;			// CRC value the server calculated for the file.
+	};
+
+	std::string index_path;
+	std::string owner;
+	std::unordered_map<std::string, Entry> entries;		// By absolute file path.
+	bool changed;										// There are entries that were not saved yet.
+
+	static std::string key(const std::string& filepath);
+};
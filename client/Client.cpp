@@ -1,18 +1,32 @@
 #include "Client.h"
 #include <iostream>
 #include <fstream>
+#include <array>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_set>
 #include "Request.h"
 #include "Utils.h"
+#include "FileEncryptor.h"
+#include "ContentChunker.h"
+#include "Compressor.h"
 
 // Client class, manages all the possible activity that the client can do, setting information, sending request to the server, 
 // recieving responses from the server, encryptin and decriptin data and updating the client.
 
 
-// Constructor
-Client::Client() {
-	socket_manager = new SocketManager();
+// Constructor, the client has an engine of its own.
+Client::Client() : Client(*new TransferEngine()) {
+	own_engine = true;
+}
+
+// Constructor, the client runs on the given engine together with other clients.
+Client::Client(TransferEngine& engine) : engine(&engine), own_engine(false), change_index(nullptr), session(false), retained_state{},
+	retained_crc(0) {
+	socket_manager = new SocketManager(engine.context().get_executor());
 	file_manager = new FileManager();
 	rsa_wrapper = new RSAPrivateWrapper();
+	session_ticket = new SessionTicket();
 }
 
 // Destructor
@@ -20,6 +34,65 @@ Client::~Client() {
 	delete socket_manager;
 	delete file_manager;
 	delete rsa_wrapper;
+	delete session_ticket;
+	if (own_engine)
+		delete engine;
+}
+
+/*  The function makes the client act as the other client: the same server, registered identity (username, client ID and private key)
+	and the symetric key of its last key exchange or reconnection. Used for parallel sessions of one client. */
+void Client::shareIdentity(const Client& other) {
+	socket_manager->setSocket(other.socket_manager->address(), other.socket_manager->port());
+	c_id = other.c_id;
+	c_username = other.c_username;
+	public_key = other.public_key;
+	symetric_key = other.symetric_key;
+	dropRetainedUpload();		// Encrypted by the key before.
+
+	delete rsa_wrapper;
+	rsa_wrapper = new RSAPrivateWrapper(other.rsa_wrapper->getPrivateKey());
+}
+
+/* The function sets the change index of the files that were sent, nullptr to send every file. The index is not owned by the client. */
+void Client::setChangeIndex(ChangeIndex* index) {
+	change_index = index;
+}
+
+/* The function returns the owner of the change index: client ID at the server address, files verified for another owner are sent again. */
+std::string Client::changeIndexOwner() const {
+	return Utils::hex(c_id.client_id, sizeof(c_id.client_id)) + "@" + socket_manager->address() + ":" + socket_manager->port();
+}
+
+/* The synchronous functions run the asynchronous version on the engine to the end. */
+bool Client::registration() {
+	return engine->runOne(asyncRegistration());
+}
+
+bool Client::sendPublicKey() {
+	return engine->runOne(asyncSendPublicKey());
+}
+
+bool Client::reconnect() {
+	return engine->runOne(asyncReconnect());
+}
+
+int Client::sendFile() {
+	if (!setTransferData()) {
+		return 0;		// FAILURE
+	}
+	return engine->runOne(asyncSendFile(file_to_send));
+}
+
+bool Client::sendFinalInvalidCrcRequest() {
+	if (!setTransferData()) {
+		socket_manager->close();
+		return false;
+	}
+	return engine->runOne(asyncSendFinalInvalidCrcRequest(file_to_send));
+}
+
+bool Client::beginSession() {
+	return engine->runOne(asyncBeginSession());
 }
 
 // The function sets the server information by reading from transfer.info file, gets servers IP address and port and returns true if, the
@@ -92,7 +165,8 @@ bool Client::setTransferData() {
 	line = line.substr(0, line.length() - 1);
 	c_username = line;
 
-	//Third line 
+	//Third line and the following ones: the files to send, a file name or a pattern of file names on every line.
+	files_to_send.clear();
 	if (!file_manager->readLine(line)) {
 		if (line.empty()) {
 			std::cout << "Error: Third line is empty, no filename is found in " << TRANSFER_INFO << std::endl;
@@ -101,19 +175,47 @@ bool Client::setTransferData() {
 		std::cout << "Error: Cant read third line in " << TRANSFER_INFO << std::endl;
 		return false;
 	}
+	do {
+		if (!addFilesToSend(line))
+			return false;
+	} while (file_manager->readLine(line));
+
+	if (files_to_send.empty()) {
+		std::cout << "Error: No file to send is found in " << TRANSFER_INFO << std::endl;
+		return false;
+	}
+
+	file_to_send = files_to_send.front();
+	file_manager->close();
+
+	return true;
+}
+
+// The function adds the files of one line of transfer.info to the files to send, the line is a file name or a pattern (* and ? wildcards
+// in the file name). Returns false if the file is not valid, a pattern that matches no file is not an error.
+bool Client::addFilesToSend(const std::string& line) {
+	if (Utils::isPattern(line)) {
+		for (const auto& file : Utils::expandPattern(line)) {
+			if (fileNameToSend(file).length() >= NAME_SIZE) {
+				std::cout << "Error: Invalid file name size: " << file << " in " << TRANSFER_INFO << std::endl;
+				return false;
+			}
+			files_to_send.push_back(file);
+		}
+		return true;
+	}
+
 	if (line.length() > NAME_SIZE) {
-		std::cout << "Error: Invalid file name size in third line in " << TRANSFER_INFO << std::endl;
+		std::cout << "Error: Invalid file name size in " << TRANSFER_INFO << ": " << line << std::endl;
 		return false;
 	}
 	bool valid = Utils::isValidFilePath(line);		// returns true if valid and false if not.
 	if (!valid) {
-		std::cout << "Error: not valid file path in " << TRANSFER_INFO << std::endl;
+		std::cout << "Error: not valid file path in " << TRANSFER_INFO << ": " << line << std::endl;
 		return false;
 	}
 
-	file_to_send = line;
-	file_manager->close();
-
+	files_to_send.push_back(line);
 	return true;
 }
 
@@ -229,14 +331,39 @@ bool Client::storeClientInfo() {
 	return true;
 }
 
+/*  The function starts a session: one connection to the server carries all the following requests (key exchange or reconnection,
+	file and CRC requests) until endSession, instead of a new connection for every request. Returns false if could not connect. */
+awaitable<bool> Client::asyncBeginSession() {
+	session = true;
+	co_return co_await openConnection();
+}
+
+/* The function ends the session and closes its connection. */
+void Client::endSession() {
+	session = false;
+	socket_manager->close();
+}
+
+/* The function connects to the server, unless the connection is already open (session or following request of the same operation). */
+awaitable<bool> Client::openConnection() {
+	if (socket_manager->isConnected())
+		co_return true;
+	co_return co_await socket_manager->connect();
+}
+
+/* The function closes the connection at the end of an operation, in a session it stays open for the next operation. */
+void Client::closeConnection() {
+	if (!session)
+		socket_manager->close();
+}
+
 /* The function handles the registration process, returns true if succseed and false otherwise. */
-bool Client::registration() {
+awaitable<bool> Client::asyncRegistration() {
 
-	RegistrationRequest request;
-	RegistrationSuccessResponse response;		 
+	ResponseFrame response;
 
 	if (!setTransferData()) {		
-		return false;
+		co_return false;
 	}
 	
 	std::string username = c_username;
@@ -244,50 +371,59 @@ bool Client::registration() {
 	for (auto c : username) {
 		if (!std::isalnum(c)) {
 			std::cout << "Invalid username: username shoud contain only characters and numbers, other symbols forbiden" << std::endl;
-			return false;
+			co_return false;
 		}
 	}
 
-	request.req_header.payloadSize = sizeof(request.payload);
-	strcpy_s(reinterpret_cast<char*>(request.payload.client_name.name), NAME_SIZE, username.c_str());
+	RequestFrame request(c_id, REQUEST_REGISTRATION);
+	if (!request.addName(username)) {
+		std::cout << "Invalid username: username is too long" << std::endl;
+		co_return false;
+	}
 
-	socket_manager->connect();
+	bool connected = co_await openConnection();
+	if (!connected) {
+		std::cout << "Error: Failed to connect to the server." << std::endl;
+		co_return false;
+	}
 
-	if (!socket_manager->sendRequest(reinterpret_cast<uint8_t* const>(&request), sizeof(request))) {
+	bool sent = co_await socket_manager->sendFrame(request);
+	if (!sent) {
 		std::cout << "Error: Something went wrong while tried to SEND request." << std::endl;
 		socket_manager->close();	
-		return false;
+		co_return false;
 	}
-	if (!socket_manager->receiveResponse(reinterpret_cast<uint8_t* const>(&response), sizeof(response))) {
+	bool received = co_await socket_manager->receiveFrame(response);
+	if (!received) {
 		std::cout << "Error: Something went wrong while tried to RECIEVE response." << std::endl;
 		socket_manager->close();
-		return false;
+		co_return false;
 	}
 
 	// Check recieved header
-	if (!isExpectedHeader(response.res_header, RESPONSE_REGISTRATION_SUCCESS)) {
+	if (!isExpectedHeader(response.header, RESPONSE_REGISTRATION_SUCCESS)) {
 		// Something went wrong with header check.
 		socket_manager->close();
-		return false; 
+		co_return false; 
 	}
 
 	// now need to store client info.
-	if (response.res_header.code == RESPONSE_REGISTRATION_SUCCESS) {
-		c_id = response.cid;
+	if (response.header.code == RESPONSE_REGISTRATION_SUCCESS) {
+		response.getClientID(c_id);
 		// Private key initialized here as well
 		if (!storeClientInfo()) {
 			std::cout << "Error: Something went wrong while tried to store information (registration) " << std::endl;
 			socket_manager->close();
-			return false;
+			co_return false;
 		}
 	}
 	else {
 		std::cout << "The server denied your registration. " << std::endl;
-		socket_manager->close();
-		return false;
+		closeConnection();
+		co_return false;
 	}
-	socket_manager->close();
-	return true;
+	closeConnection();
+	co_return true;
 }
 
 /* The function checks if response header that client recieves from the server is the one that he expects, if the header is expected, the function
@@ -300,6 +436,12 @@ bool Client::isExpectedHeader(const ResponseHeader& response_header, const Serve
 		return false;
 	}
 
+	if (response_header.version != CLIENT_VERSION) {		// Server answers in the version of the request, if it supports it.
+		std::cout << "Error: Server does not support protocol version " << static_cast<int>(CLIENT_VERSION)
+			<< ", it answered with version " << static_cast<int>(response_header.version) << std::endl;
+		return false;
+	}
+
 	if (response_header.code != expected_header_code)		// Not as expected
 	{
 		if (((expected_header_code == RESPONSE_REGISTRATION_SUCCESS) && (response_header.code == RESPONSE_REGISTRATION_FAILURE))) {
@@ -310,6 +452,14 @@ bool Client::isExpectedHeader(const ResponseHeader& response_header, const Serve
 			{
 				;	// Do nothing, this is a special case.	(Expected reconnection accseptence but it denied)
 			}
+			else if ((expected_header_code == RESPONSE_FILE_DELIVERED_WITH_CRC) && (response_header.code == RESPONSE_FILE_COMMITTED))
+			{
+				;	// Do nothing, this is a special case.	(File of a commit request was verified by the server)
+			}
+			else if ((expected_header_code == RESPONSE_SESSION_RESUMED) && (response_header.code == RESPONSE_RECONNECTION_DENIED))
+			{
+				;	// Do nothing, this is a special case.	(Session ticket was not accepted, reconnection follows)
+			}
 			else {
 				std::cout << "ERROR: Unexpected response code received: " << response_header.code << ". Expected for: " << expected_header_code << std::endl;
 				return false;
@@ -324,7 +474,7 @@ bool Client::isExpectedHeader(const ResponseHeader& response_header, const Serve
 	case RESPONSE_REGISTRATION_SUCCESS:
 	{
 		std::cout << std::endl << std::endl << "REGISTRATION SUCCESS" << std::endl << std::endl;
-		expectedPayloadSize = sizeof(RegistrationSuccessResponse) - sizeof(ResponseHeader);	// sizeof(ClientID) expected
+		expectedPayloadSize = CLIENT_ID_SIZE;
 		break;
 	}
 	case RESPONSE_REGISTRATION_FAILURE:
@@ -339,13 +489,14 @@ bool Client::isExpectedHeader(const ResponseHeader& response_header, const Serve
 		break;
 	}
 	case RESPONSE_FILE_DELIVERED_WITH_CRC:
+	case RESPONSE_FILE_COMMITTED:
 	{
-		expectedPayloadSize = sizeof(SendFileResponse) - sizeof(ResponseHeader);
+		expectedPayloadSize = response_header.payloadSize;			// File name is in variable size, checked while parsing.
 		break;
 	}
 	case RESPONSE_MESSAGE_DELIVERED:
 	{
-		expectedPayloadSize = sizeof(MessageDeliveredResponse) - sizeof(ResponseHeader);	// sizeof(ClientID) expected
+		expectedPayloadSize = CLIENT_ID_SIZE;
 		break;
 	}
 	case RESPONSE_RECONNECTION_ACCEPTED:
@@ -355,7 +506,17 @@ bool Client::isExpectedHeader(const ResponseHeader& response_header, const Serve
 	}
 	case RESPONSE_RECONNECTION_DENIED:
 	{
-		expectedPayloadSize = sizeof(ReconectionDeniedResponse) - sizeof(ResponseHeader);	// sizeof(ClientID) expected
+		expectedPayloadSize = CLIENT_ID_SIZE;
+		break;
+	}
+	case RESPONSE_SESSION_RESUMED:
+	{
+		expectedPayloadSize = CLIENT_ID_SIZE + RESUME_NONCE_SIZE + TICKET_SIZE;
+		break;
+	}
+	case RESPONSE_CHUNKS_MISSING:
+	{
+		expectedPayloadSize = response_header.payloadSize;			// Bitmap size depends on the query, checked while parsing.
 		break;
 	}
 	default:
@@ -373,336 +534,851 @@ bool Client::isExpectedHeader(const ResponseHeader& response_header, const Serve
 	return true;
 }
 
+/*  The function sets the symetric key from the key response: client ID followed by the symetric key encrypted with clients public key
+	and the session ticket of the key, which is saved for the next reconnection. */
+bool Client::setSymetricKey(ResponseFrame& response) {
+	ClientID cid;
+	if (!response.getClientID(cid) || response.remaining() <= TICKET_SIZE) {
+		std::cout << "Error: Invalid encrypted key in the response." << std::endl;
+		return false;
+	}
+
+	std::string key;
+	const size_t encryptedKeySize = response.remaining() - TICKET_SIZE;
+	try {
+		key = rsa_wrapper->decrypt(response.current(), static_cast<unsigned int>(encryptedKeySize));
+	}
+	catch (...) {
+		std::cout << "Error: Failed to decrypt the symetric key." << std::endl;
+		return false;
+	}
+	if (key.size() != SYMETRIC_KEY_SIZE) {
+		std::cout << "Error: Invalid symetric key size: " << key.size() << std::endl;
+		return false;
+	}
+
+	memcpy(symetric_key.symetricKey, key.data(), SYMETRIC_KEY_SIZE);
+	dropRetainedUpload();		// Encrypted by the key before.
+
+	const uint8_t* ticket = response.current() + encryptedKeySize;		// The end of the payload.
+	session_ticket->set(changeIndexOwner(), ticket, symetric_key, SessionTicket::now() + TICKET_LIFETIME);
+	session_ticket->save();
+	return true;
+}
+
 /* The function handles the key exchange process, it sends clients public key, and recieves AES key encrypted with the public key by the server,
 *  decrypt the AES key by clients private key, and stores recieved AES key. The function returns true if passed as expected
 *  and false otherwise.
 */
-bool Client::sendPublicKey() {
+awaitable<bool> Client::asyncSendPublicKey() {
 
-	SendPublicKeyRequest request;
-	SendPublicKeyResponse response;
+	ResponseFrame response;
 
 	
 	if (c_username == "") {
 		std::cout << "Error: Username is not initialized " << std::endl;
-		return false;
+		co_return false;
 	}
 
-	//Set client ID
-	memcpy(request.req_header.cid.client_id, c_id.client_id, sizeof(c_id.client_id));
-	
 	const auto RSApublic_key = rsa_wrapper->getPublicKey();
 
 	if (RSApublic_key.size() != PUBLIC_KEY_SIZE) {
 		std::cout << "Error: Invalid public key size: "<< RSApublic_key.size()<<" and supposed to be:" << PUBLIC_KEY_SIZE << std::endl;
-		return false;
+		co_return false;
 	}
 
 	// Prepare the request
-	request.req_header.payloadSize = sizeof(request.payload);
-	strcpy_s(reinterpret_cast<char*>(request.payload.client_name.name), NAME_SIZE, c_username.c_str());
-	memcpy(request.payload.key_pub.publicKey, RSApublic_key.c_str(), sizeof(request.payload.key_pub.publicKey));
+	RequestFrame request(c_id, REQUEST_SEND_PUBLIC_KEY);
+	if (!request.addName(c_username)) {
+		std::cout << "Error: Username is too long " << std::endl;
+		co_return false;
+	}
+	request.addBytes(reinterpret_cast<const uint8_t*>(RSApublic_key.data()), PUBLIC_KEY_SIZE);
 
-	socket_manager->connect();
+	bool connected = co_await openConnection();
+	if (!connected) {
+		std::cout << "Error: Failed to connect to the server." << std::endl;
+		co_return false;
+	}
 
 	// Send the request
-	if (!socket_manager->sendRequest(reinterpret_cast<uint8_t* const>(&request), sizeof(request))) {			
+	bool sent = co_await socket_manager->sendFrame(request);
+	if (!sent) {
 		std::cout << "Error: Something went wrong while tried to SEND the request." << std::endl;
 		socket_manager->close();	
-		return false;
+		co_return false;
 	}
 	// Recieve response
-	if (!socket_manager->receiveResponse(reinterpret_cast<uint8_t* const>(&response), sizeof(response))) {
+	bool received = co_await socket_manager->receiveFrame(response);
+	if (!received) {
 		std::cout << "Error: Something went wrong while tried to RECIEVE the response." << std::endl;
 		socket_manager->close();
-		return false;
+		co_return false;
 	}
 
 	// Check the header
-	if (!isExpectedHeader(response.res_header, RESPONSE_KEY_EXCHANGE)) {
+	if (!isExpectedHeader(response.header, RESPONSE_KEY_EXCHANGE)) {
 		socket_manager->close();
-		return false;
+		co_return false;
 	}
 	
-	std::string key;
-	key = rsa_wrapper->decrypt(response.payload.encrypted_sym_key, response.res_header.payloadSize - CLIENT_ID_SIZE);
-	
-	// Set clients public key
-	public_key = request.payload.key_pub;
 	// Set symetric key for the client 
-	memcpy(symetric_key.symetricKey, key.data(), SYMETRIC_KEY_SIZE);
+	if (!setSymetricKey(response)) {
+		socket_manager->close();
+		co_return false;
+	}
+
+	// Set clients public key
+	memcpy(public_key.publicKey, RSApublic_key.data(), PUBLIC_KEY_SIZE);
 	
-	socket_manager->close();
+	closeConnection();
+
+	co_return true; 
+}
 
-	return true; 
+/*  The function resumes the session by the session ticket of the last symetric key: the server opens the ticket and both sides derive
+	the new symetric key from its secret and the nonces, without RSA. The next ticket is saved. Returns false if there is no valid ticket
+	or the server did not accept it, the client reconnects then. */
+awaitable<bool> Client::resumeSession() {
+	if (!session_ticket->load(changeIndexOwner()) || !session_ticket->valid())
+		co_return false;
+
+	ResponseFrame response;
+	uint8_t clientNonce[RESUME_NONCE_SIZE];
+	AESWrapper::randomBytes(clientNonce, sizeof(clientNonce));
+
+	RequestFrame request(c_id, REQUEST_RESUME_SESSION);
+	request.addBytes(clientNonce, sizeof(clientNonce));
+	request.addBytes(session_ticket->data(), TICKET_SIZE);
+
+	bool connected = co_await openConnection();
+	if (!connected) {
+		std::cout << "Error: Failed to connect to the server." << std::endl;
+		co_return false;
+	}
+
+	bool sent = co_await socket_manager->sendFrame(request);
+	if (!sent) {
+		std::cout << "Something went wrong while tried to send Resume session request" << std::endl;
+		socket_manager->close();
+		co_return false;
+	}
+	bool received = co_await socket_manager->receiveFrame(response);
+	if (!received) {
+		std::cout << "Something went wrong while tried to recieve Resume session response" << std::endl;
+		socket_manager->close();
+		co_return false;
+	}
+	if (!isExpectedHeader(response.header, RESPONSE_SESSION_RESUMED)) {
+		socket_manager->close();
+		co_return false;
+	}
+	if (response.header.code != RESPONSE_SESSION_RESUMED) {		// RESPONSE_RECONNECTION_DENIED: not valid or expired.
+		session_ticket->clear();
+		session_ticket->save();
+		co_return false;
+	}
+
+	ClientID cid;
+	uint8_t serverNonce[RESUME_NONCE_SIZE];
+	uint8_t ticket[TICKET_SIZE];
+	if (!response.getClientID(cid) || !response.getBytes(serverNonce, sizeof(serverNonce)) || !response.getBytes(ticket, sizeof(ticket))) {
+		std::cout << "Error: Invalid Resume session response." << std::endl;
+		socket_manager->close();
+		co_return false;
+	}
+
+	symetric_key = SessionTicket::deriveKey(session_ticket->secret(), clientNonce, serverNonce);
+	dropRetainedUpload();		// Encrypted by the key before.
+	session_ticket->set(changeIndexOwner(), ticket, symetric_key, session_ticket->expiry());
+	session_ticket->save();
+	closeConnection();
+	co_return true;
 }
 
 /* The function handles reconnection process, in case that the client is already registered he doest need to generate key once again, 
-   he just send it and recieves new AES key for next file encryption. */
-bool Client::reconnect() {
+   he just send it and recieves new AES key for next file encryption. With RESUME_SESSIONS the session ticket is presented first and
+   the RSA reconnection follows only if the server did not accept it. */
+awaitable<bool> Client::asyncReconnect() {
+
+	if (RESUME_SESSIONS) {
+		bool resumed = co_await resumeSession();
+		if (resumed) {
+			co_return true;
+		}
+	}
 
-	ReconnectionRequest request;
-	ReconectionApprovedResponse response;
+	ResponseFrame response;
 
 	// Preparint the request
-	memcpy(request.req_header.cid.client_id, c_id.client_id, sizeof(c_id.client_id));
-	request.req_header.payloadSize = sizeof(request.payload);
-	strcpy_s(reinterpret_cast<char*>(request.payload.client_name.name), NAME_SIZE, c_username.c_str());
+	RequestFrame request(c_id, REQUEST_RECONNECT);
+	if (!request.addName(c_username)) {
+		std::cout << "Error: Username is too long " << std::endl;
+		co_return false;
+	}
 
-	socket_manager->connect();
+	bool connected = co_await openConnection();
+	if (!connected) {
+		std::cout << "Error: Failed to connect to the server." << std::endl;
+		co_return false;
+	}
 
 	// Sending request
-	if (!socket_manager->sendRequest(reinterpret_cast<uint8_t* const>(&request), sizeof(request))) {			
+	bool sent = co_await socket_manager->sendFrame(request);
+	if (!sent) {
 		std::cout << "Something went wrong while tried to send Reconnect request" << std::endl;
 		socket_manager->close();	// dont leave the connection open
-		return false;
+		co_return false;
 	}
 	// Recieving response
-	if (!socket_manager->receiveResponse(reinterpret_cast<uint8_t* const>(&response), sizeof(response))) {
+	bool received = co_await socket_manager->receiveFrame(response);
+	if (!received) {
 		std::cout << "Something went wrong while tried to recieve Reconnect response" << std::endl;
 		socket_manager->close();
-		return false;
+		co_return false;
 	}
 	// Check header
-	if (!isExpectedHeader(response.res_header, RESPONSE_RECONNECTION_ACCEPTED)) {
+	if (!isExpectedHeader(response.header, RESPONSE_RECONNECTION_ACCEPTED)) {
 		socket_manager->close();
-		return false;
+		co_return false;
 	}
 
 	// now need to store client info.
-	if (response.res_header.code == RESPONSE_RECONNECTION_ACCEPTED) {
-		std::string key;
-		key = rsa_wrapper->decrypt(response.payload.encrypted_sym_key, response.res_header.payloadSize - CLIENT_ID_SIZE);
-
+	if (response.header.code == RESPONSE_RECONNECTION_ACCEPTED) {
 		// Set NEW symetric key for the client 
-		memcpy(symetric_key.symetricKey, key.data(), SYMETRIC_KEY_SIZE);
-
+		if (!setSymetricKey(response)) {
+			socket_manager->close();
+			co_return false;
+		}
 	}
 	else {	// RESPONSE_RECONNECTION_DENIED
 		std::cout << "Reconnection not approved " << std::endl;	
-		socket_manager->close();
-		return false;
+		closeConnection();
+		co_return false;
 	}
-	socket_manager->close();
-	return true;
+	closeConnection();
+	co_return true;
+}
+
+/* The function returns the name of the file to send without its path, this is the name the file is stored under at the server. */
+std::string Client::fileNameToSend(const std::string& filepath) const {
+	// find the last occurrence of a path separator
+	const size_t separatorPos = filepath.find_last_of("/\\");
+
+	// extract the substring after the last separator
+	if (separatorPos != std::string::npos) {
+		return filepath.substr(separatorPos + 1);
+	}
+	return filepath;
+}
+
+/* The function sends one of the CRC requests (valid, invalid, final invalid) for the file, the response is not read here. */
+awaitable<bool> Client::sendCrcRequest(const ClientRequestCode code, const std::string fileName) {
+	RequestFrame request(c_id, code);
+	if (!request.addName(fileName)) {
+		std::cout << "Error: File name is too long." << std::endl;
+		co_return false;
+	}
+	co_return co_await socket_manager->sendFrame(request);
 }
 
 
 /*  The function handles the sending file process, it checks for file to send, read it, calculates CRC value, encrypt it with AES key,
 	and sends to the server. After recieving response from the server it checks what CRC value server got to make sure that the file transfered
-	as expected, and sends coresponding request with walid or invalid CRC. The function returns FAILURE, VALID_CRC or INVALID_CRC, depends
+	as expected, and sends coresponding request with walid or invalid CRC. With COMMIT_UPLOADS the CRC value is sent with the file and the
+	server answers file committed when it is the same, no valid CRC request. The function returns FAILURE, VALID_CRC or INVALID_CRC, depends
 	on what server responded or if any error appiered.*/
-int Client::sendFile() {
+awaitable<int> Client::asyncSendFile(const std::string filepath) {
 	const int FAILURE = 0;			// Error
 	const int VALID_CRC = 1;		// Valid crc recieved
 	const int INVALID_CRC = 2;		// Invalid crc recieved
 
-	SendFileRequest request;
-	SendFileResponse response;
+	ResponseFrame response;
 
-	if (!setTransferData()) {
-		return FAILURE;
+	const std::string filename = filepath;
+	const std::string fileName = fileNameToSend(filepath);
+		
+	if (filename.empty()) {
+		std::cout << "Error: File name is empty." << std::endl;
+		co_return FAILURE;
 	}
 
-	const std::string filename = file_to_send;
-	std::string fileName;
-	// find the last occurrence of a path separator
-	size_t separatorPos = filename.find_last_of("/\\");
+	// File that was not changed since its last verified upload is not read, encrypted or sent again. The state is taken before the
+	// file is read, so a change made while it is sent is found on the next run.
+	FileState state;
+	const bool indexed = change_index != nullptr && ChangeIndex::fileState(filename, state);
+	if (indexed && change_index->isUnchanged(filename, state)) {
+		std::cout << "File: " << filename << " not changed since its last upload, skipped." << std::endl;
+		co_return VALID_CRC;
+	}
 
-	// extract the substring after the last separator
-	if (separatorPos != std::string::npos) {
-		fileName = filename.substr(separatorPos + 1);
+	// Big files are sent by their content defined chunks, only the chunks that the server does not have yet. Other files are streamed.
+	uint32_t crc_value = 0;			// CRC value of the file, calculated while it was sent.
+	std::error_code errorCode;
+	const bool chunked = std::filesystem::file_size(filename, errorCode) >= CHUNKED_FILE_MIN_SIZE && !errorCode;
+	bool fileSent = false;
+	if (chunked) {
+		fileSent = co_await sendFileChunks(filename, fileName, crc_value, response);
 	}
 	else {
-		fileName = filename;
+		fileSent = co_await sendFileContent(filename, fileName, crc_value, response);
 	}
-
-	//Set client ID
-	memcpy(request.req_header.cid.client_id, c_id.client_id , sizeof(c_id.client_id));
-
-		
-	if (filename.empty()) {
-		std::cout << "Error: File name is empty." << std::endl;
-		return FAILURE;
+	if (!fileSent) {
+		dropRetainedUpload();
+		co_return FAILURE;
 	}
 
-	uint32_t crc_value = file_manager->calculate_crc(file_to_send);		// calculates CRC value of the file
-
 	//std::cout << "The CRC value of file: " << file_to_send << " is: " << crc_value << std::endl;
 
-	uint8_t* file = nullptr;
-	size_t bytes;
-
-	// After this "file" will point to the file byte stream, and bytes will have the size of the file in bytes.
-	if (!file_manager->readFileIntoBuffer(filename, file, bytes)) {
-		std::cout << "Error: File: " << filename << " not found." << std::endl;
-		return FAILURE;
-	}
-
-	AESWrapper aes(symetric_key);
-	const std::string encrypted = aes.encrypt(file, bytes);				//Has encrypted file
-
-	uint8_t* content = nullptr;
-	request.payload.contentSize = encrypted.size();						// content size = size of encrypted string
-	content = new uint8_t[request.payload.contentSize];					// buffer for the content
-	memcpy(content, encrypted.c_str(), request.payload.contentSize);	// copying encrypted string into content buffer
-
-	delete[] file;			// done with the file, clients responsability to free the memmory.
-
-	/* *******************************************SENDING FILE****************************************************/
-
-	//Creating full request, with our regular request + content 
-
-	size_t fileSize;			//size of new request
-	uint8_t* fileToSend;		//new request
-
-	request.req_header.payloadSize = sizeof(request.payload) + request.payload.contentSize;	
-	memcpy(request.payload.file_name.name, fileName.c_str(), NAME_SIZE);	//File name 
+	// Check servers response
 
-	//content has the encrypted file.
-	if (content == nullptr)
-	{
-		fileToSend = reinterpret_cast<uint8_t*>(&request);
-		fileSize = sizeof(request);
-	}
-	else
-	{
-		fileToSend = new uint8_t[sizeof(request) + request.payload.contentSize];		// Final buffer to send
-		memcpy(fileToSend, &request, sizeof(request));									// Set actual request
-		memcpy(fileToSend + sizeof(request), content, request.payload.contentSize);		// Add the content of the file
-		fileSize = sizeof(request) + request.payload.contentSize;						// total size
+	if (!isExpectedHeader(response.header, RESPONSE_FILE_DELIVERED_WITH_CRC)) {
+		dropRetainedUpload();
+		socket_manager->close();
+		co_return FAILURE;
 	}
 
-	socket_manager->connect();
-	// Send request
-	if (!socket_manager->sendRequest(fileToSend, fileSize))
-	{
-		delete[] content;		// Not sent, can free the memmory.
-		std::cout << " Error: Failed while tried to send \"Send File request\" " << std::endl;
+	ClientID cid;
+	uint64_t receivedContentSize = 0;
+	std::string receivedFileName;
+	uint32_t calculated_crc = 0;
+	if (!response.getClientID(cid) || !response.getUint64(receivedContentSize) || !response.getName(receivedFileName) ||
+		!response.getUint32(calculated_crc) || response.remaining() != 0) {
+		std::cout << "Error: Invalid Send File response." << std::endl;
+		dropRetainedUpload();
 		socket_manager->close();
-		return FAILURE;
+		co_return FAILURE;
 	}
 
-	delete[] content;			// Already sent, can free the memmory.
+	// std::cout << "Recieved crc value is: " << calculated_crc << std::endl;
 
-	// Recieve response
-	if (!socket_manager->receiveResponse(reinterpret_cast<uint8_t* const>(&response), sizeof(response))) {
-		std::cout << "Error: Something went wrong while tried to recieve Send File response" << std::endl;
-		socket_manager->close();
-		return FAILURE;
+	// File of a commit request is verified by the server already, no valid CRC request. A different CRC value is not committed and it is
+	// handled as before: invalid CRC request and the file is sent again.
+	if (crc_value == calculated_crc) {
+		dropRetainedUpload();		// Sent again only after an invalid CRC.
 	}
-	socket_manager->close();	// Done for the first request
-	// Check servers response
-
-	if (!isExpectedHeader(response.res_header, RESPONSE_FILE_DELIVERED_WITH_CRC)) {
-		socket_manager->close();
-		return FAILURE;
+	if (response.header.code == RESPONSE_FILE_COMMITTED && crc_value == calculated_crc) {
+		std::cout << "File: " << filename << " securly sent to the server and stored." << std::endl;
+		if (indexed) {
+			change_index->setVerified(filename, state, calculated_crc);
+		}
+		closeConnection();
+		co_return VALID_CRC;
 	}
 
-	// std::cout << "Recieved crc value is: " << response.payload.calculated_crc << std::endl;
-
-	// Server does 1 request at a time.
-	socket_manager->connect();
+	// Same connection is used for the CRC request, connect again if it was closed.
+	bool connected = co_await openConnection();
+	if (!connected) {
+		std::cout << "Error: Failed to connect to the server." << std::endl;
+		co_return FAILURE;
+	}
 
 	// If CRC from the server is right.
-	if (crc_value == response.payload.calculated_crc ) {
+	if (crc_value == calculated_crc) {
 		//std::cout << "Valid CRC" << std::endl;
-		// Prepare Valid CRC request
-		ValidCrcRequest validCksumRequest;
-		memcpy(validCksumRequest.payload.file_name.name, filename.c_str(), NAME_SIZE);
-		validCksumRequest.req_header.payloadSize = sizeof(validCksumRequest.payload);
-		memcpy(validCksumRequest.req_header.cid.client_id, c_id.client_id, sizeof(c_id.client_id));
-
-		// Send request
-		if (!socket_manager->sendRequest(reinterpret_cast<uint8_t* const>(&validCksumRequest), sizeof(validCksumRequest))) {			
-			std::cout << "Something went wrong while tried to send Reconnect request" << std::endl;
+		// Send Valid CRC request
+		bool sent = co_await sendCrcRequest(REQUEST_VALID_CRC, fileName);
+		if (!sent) {
+			std::cout << "Something went wrong while tried to send Valid CRC request" << std::endl;
 			socket_manager->close();	// dont leave the connection open
-			return FAILURE;
+			co_return FAILURE;
 		}
 
-		MessageDeliveredResponse messageDlvResponse;	// expect for approval message
+		ResponseFrame messageDlvResponse;	// expect for approval message
 
 		// Recieve responce
-		if (!socket_manager->receiveResponse(reinterpret_cast<uint8_t* const>(&messageDlvResponse), sizeof(messageDlvResponse))) {
+		bool received = co_await socket_manager->receiveFrame(messageDlvResponse);
+		if (!received) {
 			std::cout << "Something went wrong while tried to recieve Send File response" << std::endl;
 			socket_manager->close();
-			return FAILURE;
+			co_return FAILURE;
 		}		
 
 		// Header check
-		if (!isExpectedHeader(messageDlvResponse.res_header, RESPONSE_MESSAGE_DELIVERED)) {
+		if (!isExpectedHeader(messageDlvResponse.header, RESPONSE_MESSAGE_DELIVERED)) {
 			socket_manager->close();
-			return FAILURE;
+			co_return FAILURE;
 		}
 
-		std::cout << "File: " <<file_to_send <<" securly sent to the server and stored." << std::endl;
+		std::cout << "File: " <<filename <<" securly sent to the server and stored." << std::endl;
+		if (indexed) {
+			change_index->setVerified(filename, state, calculated_crc);
+		}
 
-		socket_manager->close();
-		return VALID_CRC;				// Return valid CRC to controller
+		closeConnection();
+		co_return VALID_CRC;				// Return valid CRC to controller
 	}
 	else {
 		
 		//std::cout << "This is not correct CRC value" << std::endl;
 
-		// Prepare invalid crc request
-		InvalidCrcRequest invalidCksumrquest; 		
-		memcpy(invalidCksumrquest.payload.file_name.name, filename.c_str(), NAME_SIZE);
-		invalidCksumrquest.req_header.payloadSize = sizeof(invalidCksumrquest.payload);
-		memcpy(invalidCksumrquest.req_header.cid.client_id, c_id.client_id, sizeof(c_id.client_id));
-
-		// Send request
-		if (!socket_manager->sendRequest(reinterpret_cast<uint8_t* const>(&invalidCksumrquest), sizeof(invalidCksumrquest))) {	
+		// Send invalid crc request
+		bool sent = co_await sendCrcRequest(REQUEST_INVALID_CRC, fileName);
+		if (!sent) {
 			std::cout << "Error: Something went wrong while tried to send Invalid CRC request" << std::endl;
 			socket_manager->close();	
-			return false;
+			co_return false;
 		}
 
-		socket_manager->close();
-		return INVALID_CRC;				// Return invalid CRC to controller
+		closeConnection();
+		co_return INVALID_CRC;				// Return invalid CRC to controller
 	}
 }
 
 // The function handles the process of sending final invalid CRC request, after the client recieved 3 times invalid CRC request he sends 
 // final invalid CRC request and return true if succseed and false otherwise.
-bool Client::sendFinalInvalidCrcRequest() {
+awaitable<bool> Client::asyncSendFinalInvalidCrcRequest(const std::string filepath) {
 
-	FinalInvalidCrcRequest request;
-
-	if (!setTransferData()) {
-		socket_manager->close();
-		return false;
+	bool connected = co_await openConnection();
+	if (!connected) {
+		std::cout << "Error: Failed to connect to the server." << std::endl;
+		co_return false;
 	}
 
-	const std::string filename = file_to_send;
-
-	memcpy(request.payload.file_name.name, filename.c_str(), NAME_SIZE);
-	request.req_header.payloadSize = sizeof(request.payload);
-	memcpy(request.req_header.cid.client_id, c_id.client_id, sizeof(c_id.client_id));
-
-	socket_manager->connect();
-
-	if (!socket_manager->sendRequest(reinterpret_cast<uint8_t* const>(&request), sizeof(request))) {			
+	bool sent = co_await sendCrcRequest(REQUEST_FINAL_INVALID_CRC, fileNameToSend(filepath));
+	if (!sent) {
 		std::cout << "Error: Something went wrong while tried to send Final invalid CRC request" << std::endl;
 		socket_manager->close();	
-		return false;
+		co_return false;
 	}
 
-	MessageDeliveredResponse messageDlvResponse;	// expect for approval message
+	ResponseFrame messageDlvResponse;	// expect for approval message
 
 	// Recieve responce
-	if (!socket_manager->receiveResponse(reinterpret_cast<uint8_t* const>(&messageDlvResponse), sizeof(messageDlvResponse))) {
+	bool received = co_await socket_manager->receiveFrame(messageDlvResponse);
+	if (!received) {
 		std::cout << "Something went wrong while tried to recieve Send File response" << std::endl;
 		socket_manager->close();
-		return false;
+		co_return false;
 	}
 
 	// Header check
-	if (!isExpectedHeader(messageDlvResponse.res_header, RESPONSE_MESSAGE_DELIVERED)) {
+	if (!isExpectedHeader(messageDlvResponse.header, RESPONSE_MESSAGE_DELIVERED)) {
 		socket_manager->close();
-		return false;
+		co_return false;
 	}
 	std::cout << "The server could not receive your file. " << std::endl;
+	dropRetainedUpload();
 
-	socket_manager->close();
+	closeConnection();
+	co_return true;
+}
+/*  The function streams the file to the server in one send file request: read chunk by chunk, the CRC value calculated and the chunk
+	encrypted and sent in one pass, so it is read from the disk once and never held in memory as a whole. With COMPRESS_UPLOADS a file
+	that is worth it is compressed in memory before it is encrypted (commit compressed file request).
+	In CBC mode the request is retained, when the same file (not changed) is sent again after an invalid CRC the retained request is sent
+	as it is. GCM content that is damaged on the way fails its tag, an invalid CRC of it comes from the read of the file, so it is read again.
+	crc_value is set to the CRC value of the file and response to the response of the server. Returns true if succseed and false otherwise. */
+awaitable<bool> Client::sendFileContent(const std::string filename, const std::string fileName, uint32_t& crc_value, ResponseFrame& response) {
+	FileState state;
+	const bool stated = ChangeIndex::fileState(filename, state);
+	if (stated && !retained_upload.empty() && retained_file == filename && retained_state == state) {
+		co_return co_await sendRetainedUpload(crc_value, response);
+	}
+	dropRetainedUpload();
+
+	AESWrapper aes(symetric_key);
+	FileEncryptor encryptor(*file_manager, aes, TRANSFER_CIPHER_MODE);
+
+	// Commit request carries the CRC value after the content, it is calculated while the file is encrypted and sent with the last chunk.
+	const bool commit = COMMIT_UPLOADS && TRANSFER_CIPHER_MODE == CipherMode::GCM;
+	const bool compress = commit && COMPRESS_UPLOADS;
+
+	BackgroundWork encryption(*engine);
+	encryption.start([&]() { return encryptor.open(filename, compress); });		// Compression reads the whole file.
+	bool opened = co_await encryption.wait();
+	if (!opened) {
+		std::cout << "Error: File: " << filename << " not found, empty or too big." << std::endl;
+		co_return false;
+	}
+
+	/* *******************************************SENDING FILE****************************************************/
+
+	// Content size is known before the encryption, it is the size of the padded cipher (or of the GCM records).
+	const uint64_t contentSize = encryptor.cipherSize();
+
+	const ClientRequestCode code = compress ? REQUEST_COMMIT_COMPRESSED_FILE_GCM : commit ? REQUEST_COMMIT_FILE_GCM :
+		(TRANSFER_CIPHER_MODE == CipherMode::GCM) ? REQUEST_SEND_FILE_GCM : REQUEST_SEND_FILE;
+	RequestFrame request(c_id, code);
+	request.addUint64(contentSize);
+	if (!request.addName(fileName)) {
+		std::cout << "Error: File name is too long." << std::endl;
+		co_return false;
+	}
+	if (compress) {
+		request.addUint8(encryptor.compression());
+		request.addUint64(encryptor.fileSize());
+	}
+	request.setContentSize(commit ? contentSize + CRC_CKSUM_SIZE : contentSize);
+	const bool retain = stated && TRANSFER_CIPHER_MODE == CipherMode::CBC &&
+		request.size() + contentSize + CRC_CKSUM_SIZE <= MAX_RETAINED_UPLOAD_SIZE;
+	if (retain) {
+		retained_upload.reserve(request.size() + contentSize + CRC_CKSUM_SIZE);
+		retained_upload.assign(request.data(), request.size());
+	}
+
+	bool connected = co_await openConnection();
+	if (!connected) {
+		std::cout << "Error: Failed to connect to the server." << std::endl;
+		co_return false;
+	}
+
+	// The chunks are read, CRC calculated and encrypted on the worker threads of the engine, the next chunk is prepared there while
+	// the current one is written to the socket (two buffers in turns).
+	std::array<PooledBuffer, 2> chunks;
+	auto prepareChunk = [&encryptor, commit](PooledBuffer& chunk) {
+		chunk.clear();
+		while (chunk.empty() && !encryptor.finished()) {		// Cipher may keep a partial block for the next chunk.
+			const uint8_t* cipher = nullptr;
+			size_t cipherBytes = 0;
+			if (!encryptor.nextChunk(cipher, cipherBytes))
+				return false;
+			chunk.assign(cipher, cipherBytes);
+			if (commit && encryptor.finished()) {
+				const uint32_t crc = encryptor.crc();
+				chunk.append(reinterpret_cast<const uint8_t*>(&crc), CRC_CKSUM_SIZE);
+			}
+		}
+		return true;
+	};
+
+	encryption.start([&]() { return prepareChunk(chunks[0]); });
+	bool encrypted = co_await encryption.wait();
+
+	// The request is sent together with the first encrypted chunk in one gather write, the rest of the content follows it.
+	bool requestSent = false;
+	size_t current = 0;
+	while (encrypted && !chunks[current].empty())
+	{
+		const PooledBuffer& chunk = chunks[current];
+		PooledBuffer& nextChunk = chunks[1 - current];
+		if (retain) {
+			retained_upload.append(chunk.data(), chunk.size());
+		}
+		encryption.start([&]() { return prepareChunk(nextChunk); });
+
+		bool sent = false;
+		if (requestSent) {
+			sent = co_await socket_manager->send(chunk.data(), chunk.size());
+		}
+		else {
+			const std::array<boost::asio::const_buffer, 2> requestAndChunk = { boost::asio::buffer(request.data(), request.size()),
+				boost::asio::buffer(chunk.data(), chunk.size()) };
+			sent = co_await socket_manager->send(requestAndChunk);
+		}
+		encrypted = co_await encryption.wait();		// Awaited in any case, the worker uses the encryptor and the buffer.
+		if (!sent)
+		{
+			std::cout << " Error: Failed while tried to send \"Send File request\" " << std::endl;
+			socket_manager->close();
+			co_return false;
+		}
+		requestSent = true;
+		current = 1 - current;
+	}
+	if (!encrypted) {
+		std::cout << "Error: Failed while tried to read file: " << filename << std::endl;
+		socket_manager->close();
+		co_return false;
+	}
+
+	crc_value = encryptor.crc();
+	if (retain) {
+		retained_file = filename;
+		retained_state = state;
+		retained_crc = crc_value;
+	}
+
+	// Recieve response
+	bool received = co_await socket_manager->receiveFrame(response);
+	if (!received) {
+		std::cout << "Error: Something went wrong while tried to recieve Send File response" << std::endl;
+		socket_manager->close();
+		co_return false;
+	}
+	co_return true;
+}
+
+/*  The function sends the retained send file request again, the file was not changed since it was encrypted, so it is not read or
+	encrypted again. crc_value is set to the CRC value of the file and response to the response of the server. */
+awaitable<bool> Client::sendRetainedUpload(uint32_t& crc_value, ResponseFrame& response) {
+	bool connected = co_await openConnection();
+	if (!connected) {
+		std::cout << "Error: Failed to connect to the server." << std::endl;
+		co_return false;
+	}
+
+	bool sent = co_await socket_manager->send(retained_upload.data(), retained_upload.size());
+	if (!sent) {
+		std::cout << " Error: Failed while tried to send \"Send File request\" " << std::endl;
+		socket_manager->close();
+		co_return false;
+	}
+	crc_value = retained_crc;
+
+	bool received = co_await socket_manager->receiveFrame(response);
+	if (!received) {
+		std::cout << "Error: Something went wrong while tried to recieve Send File response" << std::endl;
+		socket_manager->close();
+		co_return false;
+	}
+	co_return true;
+}
+
+/* The function drops the retained send file request, its buffer goes back to the pool. */
+void Client::dropRetainedUpload() {
+	retained_upload.release();
+	retained_file.clear();
+}
+
+/*  The function sends the file by its content defined chunks. The file is scanned (chunks, hashes and CRC value) and uploaded, see
+	uploadChunks(). A dropped connection does not start the file over: the server keeps every chunk it received, so after a new connection
+	the query answers only the chunks that are still missing and the upload resumes from there, without reading the file again.
+	crc_value is set to the CRC value of the file and response to the response of the server. Returns true if succseed and false otherwise. */
+awaitable<bool> Client::sendFileChunks(const std::string filename, const std::string fileName, uint32_t& crc_value, ResponseFrame& response) {
+	ContentChunker chunker(*file_manager);
+	BackgroundWork work(*engine);
+	work.start([&]() { return chunker.scan(filename); });
+	bool scanned = co_await work.wait();
+	if (!scanned) {
+		std::cout << "Error: File: " << filename << " not found, empty or too big." << std::endl;
+		co_return false;
+	}
+	const std::vector<ContentChunk>& chunks = chunker.chunks();
+	if (chunks.size() > MAX_FILE_CHUNKS) {
+		std::cout << "Error: File: " << filename << " has " << chunks.size() << " chunks, the server accepts up to " << MAX_FILE_CHUNKS << std::endl;
+		co_return false;
+	}
+
+	RequestFrame fileRequest(c_id, COMMIT_UPLOADS ? REQUEST_COMMIT_CHUNKED_FILE : REQUEST_SEND_CHUNKED_FILE);
+	fileRequest.addUint64(chunker.fileSize());
+	if (!fileRequest.addName(fileName)) {
+		std::cout << "Error: File name is too long." << std::endl;
+		co_return false;
+	}
+	fileRequest.addUint32(static_cast<uint32_t>(chunks.size()));
+	for (const ContentChunk& chunk : chunks) {
+		fileRequest.addBytes(chunk.hash, CHUNK_HASH_SIZE);
+	}
+	if (COMMIT_UPLOADS) {
+		fileRequest.addUint32(chunker.crc());
+	}
+
+	boost::asio::steady_timer resumeTimer(engine->context());
+	for (size_t attempt = 0; attempt <= RESUME_ATTEMPTS; attempt++) {
+		if (attempt > 0) {
+			std::cout << "Connection lost, resuming the upload of " << filename << " (" << attempt << " of " << RESUME_ATTEMPTS << ")" << std::endl;
+			resumeTimer.expires_after(RESUME_DELAY);
+			boost::system::error_code errorCode;
+			co_await resumeTimer.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, errorCode));
+		}
+
+		bool connected = co_await openConnection();
+		if (!connected) {
+			std::cout << "Error: Failed to connect to the server." << std::endl;
+			continue;
+		}
+
+		bool connectionLost = false;
+		bool uploaded = co_await uploadChunks(chunker, fileRequest, response, connectionLost);
+		if (uploaded) {
+			crc_value = chunker.crc();
+			co_return true;
+		}
+		socket_manager->close();
+		if (!connectionLost) {
+			co_return false;
+		}
+	}
+	co_return false;
+}
+
+/*  The function uploads the chunks of the scanned file on the open connection: asks the server which of them it does not have, sends only
+	them and then the send chunked file request. The server checks every chunk by its hash while it assembles the file, the chunks that did
+	not arrive intact are answered with chunks missing response instead of the file response, and only they are sent again.
+	response is set to the response of the server for the file. connection_lost is set if the upload can be resumed on a new connection.
+	Returns true if succseed and false otherwise. */
+awaitable<bool> Client::uploadChunks(ContentChunker& chunker, const RequestFrame& fileRequest, ResponseFrame& response, bool& connection_lost) {
+	const std::vector<ContentChunk>& chunks = chunker.chunks();
+	connection_lost = true;
+
+	std::vector<const ContentChunk*> missing;
+	bool queried = co_await queryMissingChunks(chunks, missing);
+	if (!queried) {
+		co_return false;
+	}
+
+	for (size_t repair = 0; repair <= REPAIR_ATTEMPTS; repair++) {
+		bool readFailed = false;
+		bool chunksSent = co_await sendChunks(chunker, missing, readFailed);
+		if (readFailed) {
+			std::cout << "Error: Failed while tried to read file, it changed while it was sent." << std::endl;
+			connection_lost = false;
+			co_return false;
+		}
+		if (!chunksSent) {
+			co_return false;
+		}
+
+		bool sent = co_await socket_manager->sendFrame(fileRequest);
+		if (!sent) {
+			std::cout << "Error: Failed while tried to send \"Send chunked file request\"" << std::endl;
+			co_return false;
+		}
+
+		bool received = co_await socket_manager->receiveFrame(response);
+		if (!received) {
+			std::cout << "Error: Something went wrong while tried to recieve Send File response" << std::endl;
+			co_return false;
+		}
+		if (response.header.code != RESPONSE_CHUNKS_MISSING) {
+			co_return true;		// File response, checked by the caller.
+		}
+
+		missing.clear();
+		if (!isExpectedHeader(response.header, RESPONSE_CHUNKS_MISSING) || !readMissingChunks(response, chunks, 0, chunks.size(), missing)) {
+			std::cout << "Error: Invalid Chunks missing response." << std::endl;
+			connection_lost = false;
+			co_return false;
+		}
+		std::cout << missing.size() << " chunks did not arrive intact, sending them again." << std::endl;
+	}
+
+	std::cout << "Error: Chunks of the file did not arrive intact " << REPAIR_ATTEMPTS + 1 << " times." << std::endl;
+	connection_lost = false;
+	co_return false;
+}
+
+/* The function asks the server which of the chunks it does not have, up to MAX_QUERY_CHUNKS in one request. Returns true if succseed. */
+awaitable<bool> Client::queryMissingChunks(const std::vector<ContentChunk>& chunks, std::vector<const ContentChunk*>& missing) {
+	for (size_t first = 0; first < chunks.size(); first += MAX_QUERY_CHUNKS) {
+		const size_t count = std::min(MAX_QUERY_CHUNKS, chunks.size() - first);
+		RequestFrame query(c_id, REQUEST_QUERY_CHUNKS);
+		query.addUint32(static_cast<uint32_t>(count));
+		for (size_t i = first; i < first + count; i++) {
+			query.addBytes(chunks[i].hash, CHUNK_HASH_SIZE);
+		}
+
+		bool sent = co_await socket_manager->sendFrame(query);
+		if (!sent) {
+			std::cout << "Error: Failed while tried to send \"Query chunks request\"" << std::endl;
+			co_return false;
+		}
+
+		ResponseFrame response;
+		bool received = co_await socket_manager->receiveFrame(response);
+		if (!received || !isExpectedHeader(response.header, RESPONSE_CHUNKS_MISSING)) {
+			std::cout << "Error: Something went wrong while tried to recieve Chunks missing response" << std::endl;
+			co_return false;
+		}
+		if (!readMissingChunks(response, chunks, first, count, missing)) {
+			std::cout << "Error: Invalid Chunks missing response." << std::endl;
+			co_return false;
+		}
+	}
+	co_return true;
+}
+
+/*  The function reads chunks missing response for count chunks from first, and adds the chunks that their bit is set to missing.
+	Returns false if the response is not for these chunks. */
+bool Client::readMissingChunks(ResponseFrame& response, const std::vector<ContentChunk>& chunks, const size_t first, const size_t count,
+	std::vector<const ContentChunk*>& missing) {
+	ClientID cid;
+	uint32_t answered = 0;
+	if (!response.getClientID(cid) || !response.getUint32(answered) || answered != count || response.remaining() != (count + 7) / 8)
+		return false;
+
+	const uint8_t* bitmap = response.current();
+	for (size_t i = 0; i < count; i++) {
+		if ((bitmap[i / 8] >> (i % 8)) & 1)
+			missing.push_back(&chunks[first + i]);
+	}
 	return true;
-}
\ No newline at end of file
+}
+
+/*  The function sends the chunks, every one as a send chunk request (frame and encrypted chunk in one buffer) and each one once, even if it
+	repeats in the file. Every chunk is encrypted on its own, the next one on the worker threads while the current one is written to the
+	socket. read_failed is set if the file could not be read. Returns true if succseed and false otherwise. */
+awaitable<bool> Client::sendChunks(ContentChunker& chunker, const std::vector<const ContentChunk*>& chunks, bool& read_failed) {
+	read_failed = false;
+
+	std::vector<const ContentChunk*> toSend;
+	std::unordered_set<std::string> hashes;
+	for (const ContentChunk* chunk : chunks) {
+		if (hashes.insert(std::string(reinterpret_cast<const char*>(chunk->hash), CHUNK_HASH_SIZE)).second)
+			toSend.push_back(chunk);
+	}
+
+	// Every buffer is drawn from the buffer pool. GCM chunks are sealed straight into the request buffer, after its frame.
+	AESWrapper aes(symetric_key);
+	PooledBuffer readBuffer(file_manager->isMapped() ? 0 : MAX_CONTENT_CHUNK_SIZE);		// Mapped chunks are not copied.
+	PooledBuffer packed;
+	std::array<PooledBuffer, 2> requests;
+	const bool compress = COMPRESS_UPLOADS && TRANSFER_CIPHER_MODE == CipherMode::GCM;
+	auto prepareRequest = [&](const ContentChunk& chunk, PooledBuffer& buffer) {
+		const uint8_t* plain = chunker.readChunk(chunk, readBuffer.data());
+		if (plain == nullptr)
+			return false;
+		const ClientRequestCode code = compress ? REQUEST_SEND_COMPRESSED_CHUNK_GCM :
+			(TRANSFER_CIPHER_MODE == CipherMode::GCM) ? REQUEST_SEND_CHUNK_GCM : REQUEST_SEND_CHUNK;
+		RequestFrame request(c_id, code);
+		if (TRANSFER_CIPHER_MODE == CipherMode::GCM) {		// GCM: nonce, cipher and tag.
+			ContentCompression compression = COMPRESSION_NONE;
+			const uint8_t* content = plain;
+			size_t contentSize = chunk.size;
+			if (compress) {
+				compression = Compressor::compress(plain, chunk.size, packed);
+				if (compression != COMPRESSION_NONE) {
+					content = packed.data();
+					contentSize = packed.size();
+				}
+			}
+			const size_t cipherSize = GCM_NONCE_SIZE + AESWrapper::sealedSize(contentSize);
+			request.addUint64(cipherSize);
+			if (compress) {
+				request.addUint8(compression);
+			}
+			request.setContentSize(cipherSize);
+			buffer.resize(request.size() + cipherSize);
+			memcpy(buffer.data(), request.data(), request.size());
+			uint8_t* nonce = buffer.data() + request.size();
+			AESWrapper::randomBytes(nonce, GCM_NONCE_SIZE);
+			aes.seal(nonce, content, contentSize, nonce + GCM_NONCE_SIZE);
+		}
+		else {
+			aes.beginEncryption();
+			const std::string& cipher = aes.encryptChunk(plain, chunk.size, true);
+			request.addUint64(cipher.size());
+			request.setContentSize(cipher.size());
+			buffer.assign(request.data(), request.size());
+			buffer.append(reinterpret_cast<const uint8_t*>(cipher.data()), cipher.size());
+		}
+		return true;
+	};
+
+	BackgroundWork work(*engine);
+	bool prepared = true;
+	if (!toSend.empty()) {
+		work.start([&]() { return prepareRequest(*toSend[0], requests[0]); });
+		prepared = co_await work.wait();
+	}
+	for (size_t i = 0; prepared && i < toSend.size(); i++) {
+		const PooledBuffer& current = requests[i % 2];
+		PooledBuffer& next = requests[(i + 1) % 2];
+		const bool hasNext = i + 1 < toSend.size();
+		if (hasNext) {
+			work.start([&]() { return prepareRequest(*toSend[i + 1], next); });
+		}
+
+		bool sent = co_await socket_manager->send(current.data(), current.size());
+		if (hasNext) {
+			prepared = co_await work.wait();		// Awaited in any case, the worker uses the chunker and the buffer.
+		}
+		if (!sent) {
+			std::cout << "Error: Failed while tried to send \"Send chunk request\"" << std::endl;
+			co_return false;
+		}
+	}
+	read_failed = !prepared;
+	co_return prepared;
+}
@@ -1,15 +1,32 @@
 #pragma once
 
+#include "TransferEngine.h"
 #include "SocketManager.h"
 #include "FileManager.h"
 #include "Request.h"
 #include "RSAWrapper.h"
 #include "AESWrapper.h"
+#include "ChangeIndex.h"
+#include "ContentChunker.h"
+#include "BufferPool.h"
+#include "SessionTicket.h"
+#include <string>
+#include <vector>
+#include <chrono>
 
 
 
 constexpr auto TRANSFER_INFO = "transfer.info";
 constexpr auto ME_INFO = "me.info";
+constexpr size_t CHUNKED_FILE_MIN_SIZE = 1024 * 1024;		// Files from this size are sent by chunks, only the chunks the server does not have.
+constexpr size_t RESUME_ATTEMPTS = 3;						// New connections to resume a chunked upload after the connection was lost.
+constexpr auto RESUME_DELAY = std::chrono::seconds(2);		// Wait before the next attempt.
+constexpr size_t REPAIR_ATTEMPTS = 3;						// Times the chunks that did not arrive intact are sent again.
+constexpr CipherMode TRANSFER_CIPHER_MODE = CipherMode::GCM;	// Encryption of the files and the chunks, the server accepts both modes.
+constexpr bool COMMIT_UPLOADS = true;						// CRC value is sent with the file and verified by the server, one round trip.
+constexpr bool COMPRESS_UPLOADS = true;						// Files and chunks are compressed before the encryption when it is worth it (GCM).
+constexpr bool RESUME_SESSIONS = true;						// Reconnection presents the session ticket first, RSA only if it is not accepted.
+constexpr size_t MAX_RETAINED_UPLOAD_SIZE = 4 * 1024 * 1024;	// CBC send file request kept for a retry after an invalid CRC, up to this size.
 
 class Client
 {
@@ -18,6 +35,7 @@ public:
 	// Functions
 
 	Client();
+	Client(TransferEngine& engine);
 	virtual ~Client();
 	bool setServerInfo();
 	bool setClientInfo();
@@ -27,20 +45,62 @@ public:
 	bool reconnect();
 	int sendFile();
 	bool sendFinalInvalidCrcRequest();
+	bool beginSession();
+	void endSession();
+	void shareIdentity(const Client& other);
+	void setChangeIndex(ChangeIndex* index);
+	std::string changeIndexOwner() const;
+	const std::vector<std::string>& filesToSend() const { return files_to_send; }
+
+	// Asynchronous versions, the functions above run them on the engine to the end. Many clients can run them together on one engine.
+	awaitable<bool> asyncRegistration();
+	awaitable<bool> asyncSendPublicKey();
+	awaitable<bool> asyncReconnect();
+	awaitable<int> asyncSendFile(const std::string filepath);
+	awaitable<bool> asyncSendFinalInvalidCrcRequest(const std::string filepath);
+	awaitable<bool> asyncBeginSession();
 
 private:
 	// Parameters
+	TransferEngine* engine;				// Engine that runs the requests of the client.
+	bool own_engine;					// Engine was created by the client, and deleted with it.
 	FileManager* file_manager;			// Manager for work with files.
 	SocketManager* socket_manager;		// Manager for work with socket.
 	RSAPrivateWrapper* rsa_wrapper;		// RSA wrapper for encryption / decryption
+	ChangeIndex* change_index;			// Files verified by the server, not sent again while not changed. Not owned.
+	SessionTicket* session_ticket;		// Ticket of the last symetric key, resumes the session without RSA.
 
 	ClientID c_id;						// Client ID
 	std::string c_username;				// Username
 	std::string file_to_send;			// Name of the file user wonder to send to the server
+	std::vector<std::string> files_to_send;	// All the files of transfer.info, file_to_send is the first one.
 	PublicKey public_key;				// Client public key
 	SymetricKey symetric_key;			// Symetric key
+	bool session;						// Connection is kept open between the requests of the session.
+
+	// Last send file request (frame and encrypted content), sent again as it is when the same file is sent again after an invalid CRC.
+	PooledBuffer retained_upload;
+	std::string retained_file;
+	FileState retained_state;
+	uint32_t retained_crc;
 
 	// Functions
 	bool isExpectedHeader(const ResponseHeader& response_header, const ServerResponseCode expected_header_code);
 	bool storeClientInfo();
+	bool setSymetricKey(ResponseFrame& response);
+	awaitable<bool> resumeSession();
+	bool addFilesToSend(const std::string& line);
+	std::string fileNameToSend(const std::string& filepath) const;
+	awaitable<bool> sendFileContent(const std::string filename, const std::string fileName, uint32_t& crc_value, ResponseFrame& response);
+	awaitable<bool> sendFileChunks(const std::string filename, const std::string fileName, uint32_t& crc_value, ResponseFrame& response);
+	awaitable<bool> uploadChunks(ContentChunker& chunker, const RequestFrame& fileRequest, ResponseFrame& response, bool& connection_lost);
+	awaitable<bool> queryMissingChunks(const std::vector<ContentChunk>& chunks, std::vector<const ContentChunk*>& missing);
+	awaitable<bool> sendChunks(ContentChunker& chunker, const std::vector<const ContentChunk*>& chunks, bool& read_failed);
+	static bool readMissingChunks(ResponseFrame& response, const std::vector<ContentChunk>& chunks, const size_t first, const size_t count,
+		std::vector<const ContentChunk*>& missing);
+	awaitable<bool> sendCrcRequest(const ClientRequestCode code, const std::string fileName);
+	awaitable<bool> sendRetainedUpload(uint32_t& crc_value, ResponseFrame& response);
+	void dropRetainedUpload();
+	awaitable<bool> openConnection();
+	void closeConnection();
 };
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "Compressor.h"
+#include <array>
+#include <cmath>
+#include <string>
+#include <filters.h>
+#include <zlib.h>
+
+constexpr size_t ENTROPY_SAMPLE_PARTS = 4;
+
+/* The function returns the Shannon entropy of the bytes of the sample, in bits per byte (0 to 8). */
+double Compressor::entropy(const uint8_t* data, const size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	const size_t partSize = ENTROPY_SAMPLE_SIZE / ENTROPY_SAMPLE_PARTS;
+	std::array<size_t, 256> counts{};
+	size_t sampled = 0;
+	if (size <= ENTROPY_SAMPLE_SIZE) {
+		for (size_t i = 0; i < size; i++)
+			counts[data[i]]++;
+		sampled = size;
+	}
+	else {		// Parts spread over the content, a text header of a binary file does not decide alone.
+		for (size_t part = 0; part < ENTROPY_SAMPLE_PARTS; part++) {
+			const uint8_t* begin = data + (size - partSize) * part / (ENTROPY_SAMPLE_PARTS - 1);
+			for (size_t i = 0; i < partSize; i++)
+				counts[begin[i]]++;
+		}
+		sampled = ENTROPY_SAMPLE_SIZE;
+	}
+
+	double bits = 0;
+	for (const size_t count : counts) {
+		if (count == 0)
+			continue;
+		const double p = static_cast<double>(count) / sampled;
+		bits -= p * std::log2(p);
+	}
+	return bits;
+}
+
+/* The function checks by the entropy of the sample if the content is worth compressing. */
+bool Compressor::compressible(const uint8_t* data, const size_t size)
+{
+	return entropy(data, size) <= MAX_COMPRESSIBLE_ENTROPY;
+}
+
+/*  The function compresses the content to packed if it is compressible and the compressed content is smaller. Returns the compression of
+	packed, COMPRESSION_NONE if the content should be sent as it is (packed is not set then). */
+ContentCompression Compressor::compress(const uint8_t* data, const size_t size, PooledBuffer& packed)
+{
+	if (!compressible(data, size))
+		return COMPRESSION_NONE;
+
+	// Compressed content is written straight to packed, up to the size of the content: more than that is not worth it.
+	packed.resize(size);
+	size_t compressedSize = size;
+	try {
+		CryptoPP::ArraySink* sink = new CryptoPP::ArraySink(packed.data(), packed.size());
+		CryptoPP::ZlibCompressor zlib(sink, COMPRESSION_LEVEL);
+		zlib.Put(data, size);
+		zlib.MessageEnd();
+		compressedSize = static_cast<size_t>(sink->TotalPutLength());
+	}
+	catch (...) {
+		return COMPRESSION_NONE;
+	}
+	if (compressedSize >= size)
+		return COMPRESSION_NONE;
+
+	packed.resize(compressedSize);
+	return COMPRESSION_ZLIB;
+}
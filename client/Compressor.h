@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "Request.h"
+#include "BufferPool.h"
+
+constexpr size_t ENTROPY_SAMPLE_SIZE = 4096;			// Bytes of the content the entropy is estimated from, in 4 parts over the content.
+constexpr double MAX_COMPRESSIBLE_ENTROPY = 7.5;		// Bits per byte, content above it is compressed already (archives, media).
+constexpr unsigned int COMPRESSION_LEVEL = 1;			// Fastest deflate level, text and logs still compress several times.
+
+/*  Adaptive compression stage before the encryption (encrypted content does not compress). The entropy of a small sample of the content
+	is estimated first, so content that is compressed already is passed as it is without spending the time to compress it. The
+	compression is chosen for every file and chunk and sent with it, the server decompresses the content after the decryption. */
+class Compressor
+{
+public:
+	static double entropy(const uint8_t* data, const size_t size);
+	static bool compressible(const uint8_t* data, const size_t size);
+	static ContentCompression compress(const uint8_t* data, const size_t size, PooledBuffer& packed);
+};
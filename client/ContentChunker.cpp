@@ -0,0 +1,114 @@
+#include "ContentChunker.h"
+#include <array>
+#include <sha.h>
+
+/* The function generates the random values of the Gear hash for every byte value (splitmix64 of a fixed seed), the client and every
+   later version of it must find the same boundaries for the same content. */
+static constexpr std::array<uint64_t, 256> gearTable()
+{
+	std::array<uint64_t, 256> table{};
+	uint64_t state = 0x6A09E667F3BCC908;
+	for (auto& value : table) {
+		state += 0x9E3779B97F4A7C15;
+		uint64_t mixed = state;
+		mixed = (mixed ^ (mixed >> 30)) * 0xBF58476D1CE4E5B9;
+		mixed = (mixed ^ (mixed >> 27)) * 0x94D049BB133111EB;
+		value = mixed ^ (mixed >> 31);
+	}
+	return table;
+}
+
+static constexpr std::array<uint64_t, 256> GEAR = gearTable();
+
+ContentChunker::ContentChunker(FileManager& file_manager) : file_manager(file_manager), file_size(0)
+{
+}
+
+ContentChunker::~ContentChunker()
+{
+	close();
+}
+
+/*  The function reads the file once and splits it to chunks: a chunk ends where the rolling hash of the last bytes has the mask bits zero,
+	not before MIN_CONTENT_CHUNK_SIZE and not after MAX_CONTENT_CHUNK_SIZE. The file is left open for readChunk().
+	Returns false if the file can not be read or it is empty. */
+bool ContentChunker::scan(const std::string& filepath)
+{
+	close();
+	if (!file_manager.map(filepath) && !file_manager.open(filepath))
+		return false;
+
+	file_size = file_manager.size();
+	if (file_size == 0) {
+		close();
+		return false;
+	}
+
+	CryptoPP::SHA256 sha;
+	std::vector<uint8_t> buffer;
+	if (!file_manager.isMapped())
+		buffer.resize(FILE_CHUNK_SIZE);
+	uint64_t rollingHash = 0;
+	size_t chunkSize = 0;			// Bytes of the current chunk so far.
+	size_t position = 0;			// Offset of the buffer in the file.
+
+	auto endChunk = [&](const uint64_t end) {
+		ContentChunk chunk;
+		chunk.offset = end - chunkSize;
+		chunk.size = static_cast<uint32_t>(chunkSize);
+		sha.Final(chunk.hash);
+		chunk_list.push_back(chunk);
+		chunkSize = 0;
+		rollingHash = 0;
+	};
+
+	while (position < file_size) {
+		const size_t bytes = (file_size - position > FILE_CHUNK_SIZE) ? FILE_CHUNK_SIZE : file_size - position;
+		const uint8_t* block = buffer.data();
+		if (file_manager.isMapped()) {
+			block = file_manager.mapped(position, bytes);		// nullptr if the file was truncated.
+		}
+		else if (!file_manager.read(buffer.data(), bytes)) {
+			block = nullptr;
+		}
+		if (block == nullptr) {
+			close();
+			return false;
+		}
+		crc_value.update(block, bytes);
+
+		size_t hashed = 0;			// Bytes of the block that were passed to the chunk hash.
+		for (size_t i = 0; i < bytes; i++) {
+			rollingHash = (rollingHash << 1) + GEAR[block[i]];
+			chunkSize++;
+			if ((chunkSize >= MIN_CONTENT_CHUNK_SIZE && (rollingHash & CONTENT_CHUNK_MASK) == 0) || chunkSize == MAX_CONTENT_CHUNK_SIZE) {
+				sha.Update(block + hashed, i + 1 - hashed);
+				hashed = i + 1;
+				endChunk(position + i + 1);
+			}
+		}
+		sha.Update(block + hashed, bytes - hashed);
+		position += bytes;
+	}
+	if (chunkSize > 0)
+		endChunk(file_size);
+	return true;
+}
+
+/*  The function returns the content of the chunk of the scanned file (chunk.size bytes): the mapped pages of the file, or the buffer the
+	chunk is read into. Returns nullptr if the file changed. */
+const uint8_t* ContentChunker::readChunk(const ContentChunk& chunk, uint8_t* const buffer) const
+{
+	if (file_manager.isMapped())
+		return file_manager.mapped(chunk.offset, chunk.size);
+	return (file_manager.seek(chunk.offset) && file_manager.read(buffer, chunk.size)) ? buffer : nullptr;
+}
+
+/* The function closes the file and forgets the chunks, the chunker can scan another file. */
+void ContentChunker::close()
+{
+	file_manager.close();
+	chunk_list.clear();
+	crc_value.reset();
+	file_size = 0;
+}
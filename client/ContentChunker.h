@@ -0,0 +1,44 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "FileManager.h"
+#include "Crc32.h"
+#include "Request.h"
+
+constexpr size_t MIN_CONTENT_CHUNK_SIZE = 16 * 1024;		// No boundary before it, avoids tiny chunks.
+constexpr size_t MAX_CONTENT_CHUNK_SIZE = 256 * 1024;		// Boundary is forced here, bounds the memory of one chunk.
+constexpr uint64_t CONTENT_CHUNK_MASK = 0xFFFF000000000000;	// 16 bits of the rolling hash, a boundary every 64 KB on average.
+
+/* Chunk of a file, by its position and the SHA-256 hash of its content. */
+struct ContentChunk
+{
+	uint64_t offset;
+	uint32_t size;
+	uint8_t hash[CHUNK_HASH_SIZE];
+};
+
+/*  Content defined chunking of a file. Boundaries are found by a Gear rolling hash of the content, so an insertion or deletion in the file
+	moves only the boundaries near it and the rest of the chunks keep their hashes, these chunks are not sent again to the server.
+	The file is scanned once: chunk boundaries, hashes and the CRC value of the whole file. Chunks are read again only to be sent.
+	A file that can be mapped is scanned and sent from the mapped pages, without copies. */
+class ContentChunker
+{
+public:
+	ContentChunker(FileManager& file_manager);
+	virtual ~ContentChunker();
+
+	bool scan(const std::string& filepath);
+	const uint8_t* readChunk(const ContentChunk& chunk, uint8_t* const buffer) const;
+	void close();
+
+	const std::vector<ContentChunk>& chunks() const { return chunk_list; }
+	size_t fileSize() const { return file_size; }
+	uint32_t crc() const { return crc_value.checksum(); }
+
+private:
+	FileManager& file_manager;				// File is kept open (or mapped) after the scan, for reading the chunks.
+	std::vector<ContentChunk> chunk_list;	// Chunks in the order of the file.
+	Crc32 crc_value;						// CRC value of the whole file.
+	size_t file_size;
+};
@@ -1,6 +1,7 @@
 #include "Controller.h"
 #include <iostream>
 #include <boost/algorithm/string/trim.hpp>
+#include "BatchUploader.h"
 
 /* Controller initialize function */
 void Controller::initialize(){
@@ -102,6 +103,12 @@ void Controller::handle_menu() {
 				//std::cout << "Error: Failed while tried to set data from:" << ME_INFO << std::endl;
 				break;
 			}
+			useChangeIndex();
+			// One connection for the key, the file and the CRC requests.
+			if (!client.beginSession()) {
+				std::cout << "Failed to connect to the server." << std::endl;
+				break;
+			}
 			if (!client.reconnect()) {
 				std::cout << "Did not succseed to reconnect" << std::endl;
 			}
@@ -109,6 +116,7 @@ void Controller::handle_menu() {
 				std::cout << "Successfuly reconnected" << std::endl;
 				sendFileHandle();
 			}
+			client.endSession();
 			break;
 		}
 		case Menu::Option::SEND_FILE:
@@ -117,6 +125,12 @@ void Controller::handle_menu() {
 				//std::cout << "Error: Failed while tried to set data from:" << ME_INFO << std::endl;
 				break;
 			}
+			useChangeIndex();
+			// One connection for the key, the file and the CRC requests.
+			if (!client.beginSession()) {
+				std::cout << "Failed to connect to the server." << std::endl;
+				break;
+			}
 			if (!client.sendPublicKey()) {
 				std::cout << "Something went wrond while tried to send public key." << std::endl;
 			}
@@ -124,13 +138,37 @@ void Controller::handle_menu() {
 				std::cout << "Successfuly sent and recieved a key" << std::endl;
 				sendFileHandle();
 			}
+			client.endSession();
+			break;
+		}
+		case Menu::Option::SEND_FILES:
+		{
+			if (!client.setClientInfo() || !client.setTransferData()) {
+				break;
+			}
+			useChangeIndex();
+			// One reconnection, the new key is shared by all the parallel sessions.
+			if (!client.beginSession()) {
+				std::cout << "Failed to connect to the server." << std::endl;
+				break;
+			}
+			const bool reconnected = client.reconnect();
+			client.endSession();
+			if (!reconnected) {
+				std::cout << "Did not succseed to reconnect" << std::endl;
+			}
+			else {
+				std::cout << "Successfuly reconnected" << std::endl;
+				sendFilesHandle();
+			}
 			break;
 		}
 		default:
 			break;
 		}
 	} while (menu_option.getValue() != 0 && 
-		(menu_option.getOptionCode() != Menu::Option::SEND_FILE && menu_option.getOptionCode() != Menu::Option::RECONNECT));	
+		(menu_option.getOptionCode() != Menu::Option::SEND_FILE && menu_option.getOptionCode() != Menu::Option::RECONNECT &&
+		 menu_option.getOptionCode() != Menu::Option::SEND_FILES));	
 		// If you choosed to send file or reconnect, the programm will stop after finishing the task.
 		// It is possible to change this while loop by repieting itself unless the user chooses to stop.
 }
@@ -170,5 +208,31 @@ void Controller::sendFileHandle() {
 			client.sendFinalInvalidCrcRequest();
 		}
 	}
+	change_index.save();
 	return;
-}
\ No newline at end of file
+}
+
+// The function sends all the files of transfer.info with a pool of parallel sessions, the user chooses the number of the sessions.
+void Controller::sendFilesHandle() {
+	size_t workers = TransferEngine::DEFAULT_WORKER_THREADS;
+	const std::string input = readInput("How many files to send in parallel?");
+	try {
+		workers = std::stoul(input);
+	}
+	catch (...) {
+		std::cout << "Invalid number, sending " << workers << " files in parallel." << std::endl;
+	}
+	if (workers == 0) {
+		workers = 1;
+	}
+
+	BatchUploader uploader(client, workers, &change_index);
+	uploader.upload(client.filesToSend());
+	change_index.save();
+}
+
+// The function loads the change index of the client, files that were not changed since their last verified upload are not sent again.
+void Controller::useChangeIndex() {
+	change_index.load(client.changeIndexOwner());
+	client.setChangeIndex(&change_index);
+}
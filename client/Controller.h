@@ -16,6 +16,7 @@ public:
 private:
 
 	Client client;
+	ChangeIndex change_index;		// Files that were sent and verified, shared by all the send options.
 
 	class Menu
 	{
@@ -26,6 +27,7 @@ private:
 			SEND_PUBLIC_KEY = 1101,			//Sending public key to the server
 			RECONNECT = 1102,				//In Case That the client is already registered
 			SEND_FILE = 1103,				//Send file		
+			SEND_FILES = 1104,				//Send all the files of transfer.info in parallel
 			MENU_EXIT = 9999
 		};
 
@@ -72,12 +74,15 @@ private:
 		{ 1, Menu::Option::REGISTRATION,	false,	"Registrater to the server."},
 		{ 2, Menu::Option::RECONNECT,		true,	"Reconnect to the server and send your file. (Once you already registered)"},
 		{ 3, Menu::Option::SEND_FILE,		true,	"Exchange keys and send your file."},
-		{ 4, Menu::Option::MENU_EXIT,		false,	"Exit."}
+		{ 4, Menu::Option::SEND_FILES,		true,	"Reconnect to the server and send all the files of transfer.info in parallel."},
+		{ 5, Menu::Option::MENU_EXIT,		false,	"Exit."}
 	};
 
 	std::string readInput(std::string info_request) const;
 	Menu validateUserChoise(std::string str);
 	void sendFileHandle();
+	void sendFilesHandle();
+	void useChangeIndex();
 
 	//system call			
 	void pause() const { system("pause"); }   // pause menu
@@ -0,0 +1,212 @@
+#include "Crc32.h"
+#include <array>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CRC32_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CRC32_PCLMUL_TARGET
+#else
+#include <cpuid.h>
+#define CRC32_PCLMUL_TARGET __attribute__((target("pclmul,sse2")))
+#endif
+#endif
+
+constexpr uint32_t CRC32_POLYNOMIAL = 0xEDB88320;		// Reflected IEEE polynomial.
+constexpr size_t FOLD_MIN_SIZE = 64;					// Folding kernel works on 4 blocks of 16 bytes at least.
+
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+/* The function generates the tables of slicing by 8: table k is the CRC of a byte followed by k zero bytes. */
+static constexpr CrcTables crcTables()
+{
+	CrcTables tables{};
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32_POLYNOMIAL : crc >> 1;
+		tables[0][i] = crc;
+	}
+	for (size_t k = 1; k < tables.size(); k++) {
+		for (uint32_t i = 0; i < 256; i++)
+			tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+	}
+	return tables;
+}
+
+static constexpr CrcTables CRC_TABLES = crcTables();
+
+/*  The function updates the CRC value with the bytes, 8 bytes at once by table lookups (slicing by 8). The words are read in little
+	endian order, as all the fields of the protocol. */
+uint32_t Crc32::computeTable(const uint8_t* data, size_t size, uint32_t crc)
+{
+	const auto& t = CRC_TABLES;
+	crc = ~crc;
+	while (size >= 8) {
+		uint32_t low, high;
+		std::memcpy(&low, data, sizeof(low));
+		std::memcpy(&high, data + 4, sizeof(high));
+		low ^= crc;
+		crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+			t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+		data += 8;
+		size -= 8;
+	}
+	while (size-- > 0)
+		crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+#ifdef CRC32_X86
+/*  Folding kernel ("Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction", Intel): 4 blocks of 16 bytes are folded
+	forward by carry-less multiplication in every step, then folded to one block and reduced to 32 bits (Barrett reduction).
+	crc is the inner (inverted) CRC state, size is at least FOLD_MIN_SIZE and a multiple of 16. */
+CRC32_PCLMUL_TARGET static uint32_t foldPclmul(const uint8_t* data, size_t size, uint32_t crc)
+{
+	alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };		// x^(4*128+32) and x^(4*128-32) mod P
+	alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };		// x^(128+32) and x^(128-32) mod P
+	alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };		// x^64 mod P
+	alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };		// P and floor(x^64 / P)
+
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+	x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00));
+	x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10));
+	x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20));
+	x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+	x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+	data += 64;
+	size -= 64;
+
+	// Fold 4 blocks at once.
+	while (size >= 64) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 0x30)));
+		data += 64;
+		size -= 64;
+	}
+
+	// Fold the 4 blocks to one.
+	x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// Fold the rest, one block at once.
+	while (size >= 16) {
+		x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+		data += 16;
+		size -= 16;
+	}
+
+	// Fold 128 bits to 64 bits.
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+	x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits.
+	x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+
+/* The function checks if the CPU has the carry-less multiplication instruction (CPUID 1, ECX bit 1). */
+static bool hasPclmul()
+{
+#if defined(_MSC_VER)
+	int info[4] = { 0 };
+	__cpuid(info, 1);
+	return (info[2] & (1 << 1)) != 0;
+#else
+	unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) != 0;
+#endif
+}
+#endif
+
+/* The function returns true if the folding kernel is used, the CPU is checked once. */
+bool Crc32::accelerated()
+{
+#ifdef CRC32_X86
+	static const bool pclmul = hasPclmul();
+	return pclmul;
+#else
+	return false;
+#endif
+}
+
+/*  The function updates the CRC value with the bytes, by the folding kernel if the CPU has it (the 16 byte blocks) and by the tables
+	(the rest of the bytes and small inputs). crc is the CRC value of the bytes before, 0 for the first bytes. */
+uint32_t Crc32::compute(const uint8_t* data, size_t size, uint32_t crc)
+{
+#ifdef CRC32_X86
+	if (size >= FOLD_MIN_SIZE && accelerated()) {
+		const size_t folded = size & ~static_cast<size_t>(15);
+		crc = ~foldPclmul(data, folded, ~crc);
+		data += folded;
+		size -= folded;
+	}
+#endif
+	return computeTable(data, size, crc);
+}
+
+/* The function multiplies a and b modulo the polynomial, polynomials in the reflected bit order. */
+static uint32_t multiplyModulo(uint32_t a, uint32_t b)
+{
+	uint32_t product = 0;
+	for (uint32_t bit = 1u << 31; bit != 0; bit >>= 1) {
+		if (a & bit) {
+			product ^= b;
+			if ((a & (bit - 1)) == 0)
+				break;
+		}
+		b = (b & 1) ? (b >> 1) ^ CRC32_POLYNOMIAL : b >> 1;
+	}
+	return product;
+}
+
+/*  The function combines the CRC values of two consecutive parts: crc1 of the first part and crc2 of the second part of size2 bytes.
+	Returns the CRC value of both parts together: crc1 shifted over size2 zero bytes (multiplied by x^(8*size2) modulo the polynomial)
+	and added to crc2. Takes log(size2) multiplications, the parts are not read again. */
+uint32_t Crc32::combine(const uint32_t crc1, const uint32_t crc2, const uint64_t size2)
+{
+	uint32_t shift = 1u << 31;				// x^0
+	uint32_t square = 1u << 23;				// x^8, one byte
+	for (uint64_t bytes = size2; bytes != 0; bytes >>= 1) {
+		if (bytes & 1)
+			shift = multiplyModulo(square, shift);
+		square = multiplyModulo(square, square);
+	}
+	return multiplyModulo(shift, crc1) ^ crc2;
+}
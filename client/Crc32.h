@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/*  CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320), the same value as zlib.crc32 of the server and boost::crc_32_type.
+	The bytes are processed by the fastest kernel of the CPU, chosen once at run time: folding with carry-less multiplication (PCLMULQDQ)
+	on x86 CPUs that have it, and slicing by 8 tables everywhere else. CRC values of consecutive parts can be combined, so a big input can
+	be split to segments that are checksummed in parallel. */
+class Crc32
+{
+public:
+	Crc32() : crc_value(0) {}
+
+	void update(const uint8_t* data, const size_t size) { crc_value = compute(data, size, crc_value); }
+	void reset() { crc_value = 0; }
+	uint32_t checksum() const { return crc_value; }
+
+	static uint32_t compute(const uint8_t* data, const size_t size, const uint32_t crc = 0);
+	static uint32_t computeTable(const uint8_t* data, const size_t size, const uint32_t crc = 0);
+	static uint32_t combine(const uint32_t crc1, const uint32_t crc2, const uint64_t size2);
+	static bool accelerated();
+
+private:
+	uint32_t crc_value;		// CRC value of the bytes so far.
+};
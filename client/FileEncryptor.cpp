@@ -0,0 +1,141 @@
+#include "FileEncryptor.h"
+#include <cstring>
+
+static_assert(FILE_CHUNK_SIZE == GCM_RECORD_SIZE, "GCM mode seals every chunk of the file as one record");
+
+FileEncryptor::FileEncryptor(FileManager& file_manager, AESWrapper& aes, const CipherMode mode) : file_manager(file_manager), aes(aes),
+	mode(mode), file_size(0), plain_size(0), bytes_left(0), source(nullptr), crc_done(false), compression_value(COMPRESSION_NONE),
+	nonce{ 0 }, record_index(0)
+{
+}
+
+FileEncryptor::~FileEncryptor()
+{
+	close();
+}
+
+/*  The function opens the file (maps it if it can) and prepares the encryption of it. With compress a file up to MAX_COMPRESSED_FILE_SIZE
+	is read and compressed now, if it is compressible. Returns false if the file can not be opened or it is empty. */
+bool FileEncryptor::open(const std::string& filepath, const bool compress)
+{
+	close();
+	if (!file_manager.map(filepath) && !file_manager.open(filepath))
+		return false;
+
+	file_size = file_manager.size();
+	if (file_size == 0) {
+		close();
+		return false;
+	}
+
+	plain_size = file_size;
+	crc_value.reset();
+	if (compress && file_size <= MAX_COMPRESSED_FILE_SIZE) {
+		content.resize(file_size);		// A mapped file is copied as well, it may be truncated while it is compressed.
+		if (!file_manager.read(content.data(), file_size)) {
+			close();
+			return false;
+		}
+		file_manager.close();
+		source = content.data();
+		crc_value.update(source, file_size);		// CRC value is of the file, the server checks it after the decompression.
+		crc_done = true;
+
+		PooledBuffer packed;
+		compression_value = Compressor::compress(source, file_size, packed);
+		if (compression_value != COMPRESSION_NONE) {
+			content.swap(packed);
+			source = content.data();
+			plain_size = content.size();
+		}
+	}
+
+	bytes_left = plain_size;
+	if (source == nullptr && !file_manager.isMapped()) {
+		chunk.resize(FILE_CHUNK_SIZE);
+	}
+	if (mode == CipherMode::GCM) {
+		AESWrapper::randomBytes(nonce, GCM_NONCE_PREFIX_SIZE);
+		record_index = 0;
+	}
+	else {
+		aes.beginEncryption();
+	}
+	return true;
+}
+
+/* The function returns the size of the content, known before the encryption: CBC pads the cipher, GCM adds the prefix and the tags. */
+size_t FileEncryptor::cipherSize() const
+{
+	if (mode == CipherMode::GCM) {
+		const size_t records = (plain_size + GCM_RECORD_SIZE - 1) / GCM_RECORD_SIZE;
+		return GCM_NONCE_PREFIX_SIZE + plain_size + records * GCM_TAG_SIZE;
+	}
+	return AESWrapper::cipherSize(plain_size);
+}
+
+/* The function closes the file, the stage can be opened again for another file. */
+void FileEncryptor::close()
+{
+	file_manager.close();
+	file_size = 0;
+	plain_size = 0;
+	bytes_left = 0;
+	content.release();
+	source = nullptr;
+	crc_done = false;
+	compression_value = COMPRESSION_NONE;
+}
+
+/*  The function reads the next chunk of the file, updates the CRC value with it and encrypts it. cipher and size are set to the encrypted
+	bytes that are ready to be sent, size may be 0 when the cipher keeps a partial block for the next chunk. Returns false on read error. */
+bool FileEncryptor::nextChunk(const uint8_t*& cipher, size_t& size)
+{
+	cipher = nullptr;
+	size = 0;
+	if (finished())
+		return false;
+
+	const size_t bytesInChunk = (bytes_left > FILE_CHUNK_SIZE) ? FILE_CHUNK_SIZE : bytes_left;
+	const uint8_t* plain = chunk.data();
+	if (source != nullptr) {
+		plain = source + (plain_size - bytes_left);
+	}
+	else if (file_manager.isMapped()) {
+		plain = file_manager.mapped(file_size - bytes_left, bytesInChunk);		// nullptr if the file was truncated.
+	}
+	else if (!file_manager.read(chunk.data(), bytesInChunk)) {
+		plain = nullptr;
+	}
+	if (plain == nullptr) {
+		close();
+		return false;
+	}
+	if (!crc_done) {
+		crc_value.update(plain, bytesInChunk);
+	}
+	bytes_left -= bytesInChunk;
+
+	if (mode == CipherMode::GCM) {
+		size_t sealedSize = 0;
+		sealed.resize(GCM_NONCE_PREFIX_SIZE + AESWrapper::sealedSize(bytesInChunk));
+		if (record_index == 0) {
+			std::memcpy(sealed.data(), nonce, GCM_NONCE_PREFIX_SIZE);
+			sealedSize = GCM_NONCE_PREFIX_SIZE;
+		}
+		const uint32_t index = record_index++ | (finished() ? GCM_LAST_RECORD : 0);
+		std::memcpy(nonce + GCM_NONCE_PREFIX_SIZE, &index, sizeof(index));		// little endian, as all the fields of the protocol.
+		sealedSize += aes.seal(nonce, plain, bytesInChunk, sealed.data() + sealedSize);
+		sealed.resize(sealedSize);
+		cipher = sealed.data();
+		size = sealed.size();
+	}
+	else {
+		const std::string& encrypted = aes.encryptChunk(plain, bytesInChunk, finished());
+		cipher = reinterpret_cast<const uint8_t*>(encrypted.data());
+		size = encrypted.size();
+	}
+	if (finished())
+		file_manager.close();
+	return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include "FileManager.h"
+#include "BufferPool.h"
+#include "Crc32.h"
+#include "AESWrapper.h"
+#include "Compressor.h"
+
+constexpr size_t MAX_COMPRESSED_FILE_SIZE = 16 * 1024 * 1024;	// File is compressed in memory as a whole, bigger files are streamed.
+
+/* Single pass upload stage. Every chunk of the file is read from the disk once, the CRC value is updated from it and the same
+   (cache hot) buffer is passed to the AES encryption, so there is no separate read of the file only for the CRC. A file that can be
+   mapped is not copied at all, the chunks are the pages of the mapped file.
+   In GCM mode every chunk is one record, sealed on its own with the nonce prefix of the file and its index, the content starts with
+   the nonce prefix.
+   With compression the file is read to memory when it is opened and compressed there if it is worth it (see Compressor), the records
+   are of the compressed content. Its size must be known before the content is sent.
+   All the buffers are drawn from the buffer pool and returned to it with the encryptor. */
+class FileEncryptor
+{
+public:
+	FileEncryptor(FileManager& file_manager, AESWrapper& aes, const CipherMode mode = CipherMode::CBC);
+	virtual ~FileEncryptor();
+
+	bool open(const std::string& filepath, const bool compress = false);
+	void close();
+	bool nextChunk(const uint8_t*& cipher, size_t& size);
+	bool finished() const { return bytes_left == 0; }
+
+	size_t fileSize() const { return file_size; }
+	size_t plainSize() const { return plain_size; }
+	size_t cipherSize() const;
+	uint32_t crc() const { return crc_value.checksum(); }
+	ContentCompression compression() const { return compression_value; }
+
+private:
+	FileManager& file_manager;			// Opened file is read by the file manager.
+	AESWrapper& aes;					// Encryption of the chunks.
+	const CipherMode mode;
+	Crc32 crc_value;					// CRC value of the bytes read so far.
+	PooledBuffer chunk;					// Plain chunk buffer, reused for every chunk.
+	size_t file_size;					// File size in bytes.
+	size_t plain_size;					// Bytes that are encrypted, the file or its compressed content.
+	size_t bytes_left;					// Bytes that were not read yet.
+	PooledBuffer content;				// Compression: the whole file or its compressed content.
+	const uint8_t* source;				// All the plain bytes in the memory (content), nullptr if they are read or mapped.
+	bool crc_done;						// CRC value of the whole file was calculated when it was opened.
+	ContentCompression compression_value;
+	uint8_t nonce[GCM_NONCE_SIZE];		// GCM: random prefix of the file and the index of the next record.
+	uint32_t record_index;
+	PooledBuffer sealed;				// GCM: output of the last record, reused between records.
+};
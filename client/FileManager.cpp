@@ -3,9 +3,26 @@
 #include "FileManager.h"
 #include <fstream>
 #include <iostream>
-#include <boost/crc.hpp>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include "Crc32.h"
 
-FileManager::FileManager() : fstream(nullptr), isOpen(false)	
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileManager::FileManager() : fstream(nullptr), isOpen(false), mapped_data(nullptr), mapped_size(0), mapped_position(0),
+	mapping_handle(nullptr), mapped_file(-1)
 {
 }
 
@@ -37,9 +54,102 @@ bool FileManager::open(const std::string& path, bool write) {
 }
 
 
+/*  The function maps the file read-only into the memory, mapped() is the file itself: the stages read the pages of the page cache, without
+	a copy to a buffer of theirs and without allocating the size of the file. The pages are read ahead in order (sequential access).
+	read(), seek() and size() work on the mapped file as well. Returns false if the file can not be mapped or it is smaller than
+	MIN_MAPPED_FILE_SIZE, open() it then. A file that is truncated while it is mapped fails as a changed file (see mapped()). */
+bool FileManager::map(const std::string& path)
+{
+	close();
+	if (path.empty())
+		return false;
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(MIN_MAPPED_FILE_SIZE) ||
+		static_cast<uint64_t>(fileSize.QuadPart) > SIZE_MAX) {
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);		// The mapping object keeps the file.
+	if (mapping == nullptr)
+		return false;
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr) {
+		CloseHandle(mapping);
+		return false;
+	}
+	mapping_handle = mapping;
+	mapped_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	const int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(MIN_MAPPED_FILE_SIZE) ||
+		static_cast<uint64_t>(status.st_size) > SIZE_MAX) {
+		::close(file);
+		return false;
+	}
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	if (data == MAP_FAILED) {
+		::close(file);
+		return false;
+	}
+	madvise(data, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+	mapped_size = static_cast<size_t>(status.st_size);
+	mapped_file = file;		// Kept open for the size checks of mapped().
+#endif
+	mapped_data = static_cast<const uint8_t*>(data);
+	mapped_position = 0;
+	return true;
+}
+
+
+/* The function releases the view of the mapped file. */
+void FileManager::unmap()
+{
+	if (mapped_data == nullptr)
+		return;
+#if defined(_WIN32)
+	UnmapViewOfFile(mapped_data);
+	CloseHandle(mapping_handle);
+#else
+	munmap(const_cast<uint8_t*>(mapped_data), mapped_size);
+	::close(mapped_file);
+#endif
+	mapped_data = nullptr;
+	mapped_size = 0;
+	mapped_position = 0;
+	mapping_handle = nullptr;
+	mapped_file = -1;
+}
+
+
+/*  The function returns the bytes of the mapped file from offset, nullptr if they are not in the file. The pages past the end of a file
+	that was truncated while it is mapped are lost, reading them raises SIGBUS (POSIX), so the size of the file is checked before every
+	read of the pages: the bytes of a truncated file are not returned, as a short read of a stream. Windows does not allow the truncation. */
+const uint8_t* FileManager::mapped(const size_t offset, const size_t bytes) const
+{
+	if (!isMapped() || offset > mapped_size || bytes > mapped_size - offset)
+		return nullptr;
+#if !defined(_WIN32)
+	struct stat status;
+	if (fstat(mapped_file, &status) != 0 || static_cast<uint64_t>(status.st_size) < static_cast<uint64_t>(offset) + bytes)
+		return nullptr;
+#endif
+	return mapped_data + offset;
+}
+
+
 // The functiom closes file stream
 void FileManager::close()
 {
+	unmap();
 	try
 	{
 		if (fstream != nullptr)
@@ -59,6 +169,8 @@ void FileManager::close()
 /* The function calculate the file size which is opened by file stream. */
 size_t FileManager::size() const
 {
+	if (isMapped())
+		return mapped_size;
 	if (fstream == nullptr || !isOpen)
 		return 0;
 	try
@@ -66,7 +178,7 @@ size_t FileManager::size() const
 		const auto cur = fstream->tellg();
 		fstream->seekg(0, std::fstream::end);
 		const auto size = fstream->tellg();
-		if ((size <= 0) || (size > UINT32_MAX))    // do not support more than uint32 max size files. (up to 4GB).
+		if ((size <= 0) || (static_cast<uint64_t>(size) > SIZE_MAX))    // file must fit the address space (32-bit builds: up to 4GB).
 			return 0;
 		fstream->seekg(cur);    // restore position
 		return static_cast<size_t>(size);
@@ -80,13 +192,49 @@ size_t FileManager::size() const
 /* This function attempts to read a sequence of bytes from an open file and store them in the memory location pointed to by the dest parameter. */
 bool FileManager::read(uint8_t* const dest, const size_t bytes) const
 {
+	if (isMapped()) {
+		for (size_t copied = 0; copied < bytes;) {		// The size of the file is checked before every piece, see mapped().
+			const size_t piece = std::min(bytes - copied, MAPPED_READ_SIZE);
+			const uint8_t* source = mapped(mapped_position, piece);
+			if (source == nullptr)
+				return false;
+			std::memcpy(dest + copied, source, piece);
+			mapped_position += piece;
+			copied += piece;
+		}
+		return true;
+	}
 	if (fstream == nullptr || !isOpen)
 		return false;
 	try
 	{
 		fstream->read(reinterpret_cast<char*>(dest), bytes);
+		return fstream->gcount() == static_cast<std::streamsize>(bytes);	// short read means the file changed or ended.
+	}
+	catch (...)
+	{
+		return false;
+	}
+}
+
+
+/* The function moves the read position of the open file to the offset from its beginning. */
+bool FileManager::seek(const size_t offset) const
+{
+	if (isMapped()) {
+		if (offset > mapped_size)
+			return false;
+		mapped_position = offset;
 		return true;
 	}
+	if (fstream == nullptr || !isOpen)
+		return false;
+	try
+	{
+		fstream->clear();		// a read that reached the end leaves the stream failed.
+		fstream->seekg(static_cast<std::streamoff>(offset), std::fstream::beg);
+		return !fstream->fail();
+	}
 	catch (...)
 	{
 		return false;
@@ -157,22 +305,70 @@ bool FileManager::readFileIntoBuffer(const std::string& filepath, uint8_t*& file
 	return success;
 }
 
-/* This function calculates the CRC checksum value of a file with the given filename. The function returns calculated CRC value. */
-uint32_t FileManager::calculate_crc(const std::string& filename) {
+/*  This function calculates the CRC checksum value of a file with the given filename. Big files are split to segments (up to one for
+	every thread, 0 threads is one for every core) that are read and checksummed in parallel, the CRC values of the segments are combined
+	in their order. The segments are checksummed from the mapped file when it can be mapped, and read otherwise.
+	The function returns calculated CRC value, 0 if the file can not be read. */
+uint32_t FileManager::calculate_crc(const std::string& filename, size_t threads) {
 
-	// Open the file in binary mode	
-	std::ifstream file(filename, std::ios::binary);
+	std::error_code errorCode;		// without this file_size() will throw exception.
+	const uint64_t fileSize = std::filesystem::file_size(filename, errorCode);
+	if (errorCode)
+		return 0;
 
-	// Calculate the CRC checksum value using Boost C++ library
-	boost::crc_32_type result;
-	char buffer[4096];
-	while (file.read(buffer, sizeof(buffer))) {
-		result.process_bytes(buffer, sizeof(buffer));
-	}
-	result.process_bytes(buffer, file.gcount());
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = static_cast<size_t>(std::max<uint64_t>(1, std::min<uint64_t>(threads, fileSize / PARALLEL_CRC_MIN_SIZE)));
+	const uint64_t segmentSize = (fileSize + threads - 1) / threads;
 
-	// Close the file
-	file.close();
+	FileManager mappedFile;
+	const bool isMapped = mappedFile.map(filename) && mappedFile.size() == fileSize;
 
-	return result.checksum();
-}
\ No newline at end of file
+	std::vector<uint32_t> crcs(threads, 0);
+	std::vector<uint8_t> succeeded(threads, 0);
+	auto segmentCrc = [&](const size_t segment) {
+		const uint64_t begin = segment * segmentSize;
+		uint64_t bytesLeft = std::min(segmentSize, fileSize - begin);
+
+		if (isMapped) {
+			Crc32 crc;
+			for (uint64_t offset = begin; bytesLeft > 0;) {		// The size of the file is checked before every piece, see mapped().
+				const size_t piece = static_cast<size_t>(std::min<uint64_t>(bytesLeft, MAPPED_READ_SIZE));
+				const uint8_t* data = mappedFile.mapped(static_cast<size_t>(offset), piece);
+				if (data == nullptr)
+					break;
+				crc.update(data, piece);
+				offset += piece;
+				bytesLeft -= piece;
+			}
+			crcs[segment] = crc.checksum();
+			succeeded[segment] = (bytesLeft == 0);
+			return;
+		}
+		std::ifstream file(filename, std::ios::binary);
+		file.seekg(static_cast<std::streamoff>(begin));
+		std::vector<char> buffer(CRC_READ_SIZE);
+		Crc32 crc;
+		while (bytesLeft > 0 && file.read(buffer.data(), std::min<uint64_t>(bytesLeft, buffer.size()))) {
+			crc.update(reinterpret_cast<const uint8_t*>(buffer.data()), static_cast<size_t>(file.gcount()));
+			bytesLeft -= file.gcount();
+		}
+		crcs[segment] = crc.checksum();
+		succeeded[segment] = (bytesLeft == 0);
+	};
+
+	std::vector<std::thread> workers;
+	for (size_t segment = 1; segment < threads; segment++)
+		workers.emplace_back(segmentCrc, segment);
+	segmentCrc(0);
+	for (auto& worker : workers)
+		worker.join();
+
+	uint32_t result = crcs[0];
+	for (size_t segment = 1; segment < threads; segment++) {
+		if (!succeeded[segment])
+			return 0;
+		result = Crc32::combine(result, crcs[segment], std::min(segmentSize, fileSize - segment * segmentSize));
+	}
+	return succeeded[0] ? result : 0;
+}
@@ -2,6 +2,12 @@
 #include <string>
 #include <fstream>
 
+constexpr size_t FILE_CHUNK_SIZE = 64 * 1024;	// Size of a file chunk that read at once while streaming.
+constexpr size_t CRC_READ_SIZE = 1024 * 1024;				// Bytes read at once while calculating the CRC value of a file.
+constexpr uint64_t PARALLEL_CRC_MIN_SIZE = 64 * 1024 * 1024;	// Smaller files are not split, every segment is at least this size.
+constexpr size_t MIN_MAPPED_FILE_SIZE = 64 * 1024;				// Smaller files are read, mapping them costs more than the copy.
+constexpr size_t MAPPED_READ_SIZE = 1024 * 1024;				// Bytes of the mapped file read after one check of its size.
+
 class FileManager
 {
 public:
@@ -12,18 +18,29 @@ public:
 
     //      Functions
     bool open(const std::string& path, bool write = false);
+    bool map(const std::string& path);
     void close();
     bool read(uint8_t* const dest, const size_t bytes) const;
+    bool seek(const size_t offset) const;
     bool write(const uint8_t* const src, const size_t bytes) const;
     bool readLine(std::string& line) const;
     bool writeLine(const std::string& line) const;
     bool readServerInfo();
     bool readFileIntoBuffer(const std::string& filepath, uint8_t*& file, size_t& bytes);
     size_t size() const;
+    bool isMapped() const { return mapped_data != nullptr; }
+    const uint8_t* mapped(const size_t offset, const size_t bytes) const;
 
-    uint32_t calculate_crc(const std::string& filename);
+    uint32_t calculate_crc(const std::string& filename, size_t threads = 0);
 
 private:
     std::fstream* fstream;
     bool isOpen;  // file status (open/closed)
+    const uint8_t* mapped_data;         // Read-only view of the mapped file, nullptr if the file is not mapped.
+    size_t mapped_size;
+    mutable size_t mapped_position;     // Position of read() in the mapped file.
+    void* mapping_handle;               // Windows: file mapping object of the view.
+    int mapped_file;                    // POSIX: descriptor of the mapped file, its size is checked before the pages are read.
+
+    void unmap();
 };
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "Frame.h"
+#include <cstring>
+
+RequestFrame::RequestFrame(const ClientID& cid, const ClientRequestCode code) : content_size(0)
+{
+	const RequestHeader header(cid, code);
+	buffer.reserve(sizeof(RequestHeader) + 1 + NAME_SIZE + PUBLIC_KEY_SIZE);	// enough for the biggest control request
+	addBytes(reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+}
+
+void RequestFrame::addUint8(const uint8_t value)
+{
+	addBytes(&value, sizeof(value));
+}
+
+void RequestFrame::addUint16(const uint16_t value)
+{
+	addBytes(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+}
+
+void RequestFrame::addUint32(const uint32_t value)
+{
+	addBytes(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+}
+
+void RequestFrame::addUint64(const uint64_t value)
+{
+	addBytes(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+}
+
+void RequestFrame::addBytes(const uint8_t* const bytes, const size_t size)
+{
+	buffer.append(bytes, size);
+	updatePayloadSize();
+}
+
+/* The function adds length prefixed name, returns false if the name is too long for the protocol. */
+bool RequestFrame::addName(const std::string& name)
+{
+	if (name.size() >= NAME_SIZE)
+		return false;
+	addUint8(static_cast<uint8_t>(name.size()));
+	addBytes(reinterpret_cast<const uint8_t*>(name.data()), name.size());
+	return true;
+}
+
+/* The function sets the size of the content that is sent right after the frame. */
+void RequestFrame::setContentSize(const size_t size)
+{
+	content_size = size;
+	updatePayloadSize();
+}
+
+/* The function updates the payload size in the header of the frame. */
+void RequestFrame::updatePayloadSize()
+{
+	if (buffer.size() < sizeof(RequestHeader))
+		return;
+	const uint64_t payloadSize = buffer.size() - sizeof(RequestHeader) + content_size;
+	memcpy(buffer.data() + offsetof(RequestHeader, payloadSize), &payloadSize, sizeof(payloadSize));
+}
+
+/* The function prepares the frame for the next response, the memory of the payload is kept for it. */
+void ResponseFrame::reset()
+{
+	header = ResponseHeader();
+	payload.clear();
+	offset = 0;
+}
+
+bool ResponseFrame::getUint8(uint8_t& value)
+{
+	return getBytes(&value, sizeof(value));
+}
+
+bool ResponseFrame::getUint16(uint16_t& value)
+{
+	return getBytes(reinterpret_cast<uint8_t*>(&value), sizeof(value));
+}
+
+bool ResponseFrame::getUint32(uint32_t& value)
+{
+	return getBytes(reinterpret_cast<uint8_t*>(&value), sizeof(value));
+}
+
+bool ResponseFrame::getUint64(uint64_t& value)
+{
+	return getBytes(reinterpret_cast<uint8_t*>(&value), sizeof(value));
+}
+
+/* The function copies the next bytes of the payload, returns false if there are not enough of them. */
+bool ResponseFrame::getBytes(uint8_t* const bytes, const size_t size)
+{
+	if (remaining() < size)
+		return false;
+	memcpy(bytes, payload.data() + offset, size);
+	offset += size;
+	return true;
+}
+
+/* The function reads length prefixed name. */
+bool ResponseFrame::getName(std::string& name)
+{
+	uint8_t length = 0;
+	if (!getUint8(length) || remaining() < length)
+		return false;
+	name.assign(reinterpret_cast<const char*>(payload.data() + offset), length);
+	offset += length;
+	return true;
+}
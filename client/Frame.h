@@ -0,0 +1,54 @@
+#pragma once
+#include <string>
+#include "Request.h"
+#include "BufferPool.h"
+
+/* Protocol v5 request frame: the request header followed by exactly payloadSize bytes, without packet padding.
+   Fields are little endian as the header itself, names are variable length and prefixed by their length (1 byte). */
+class RequestFrame
+{
+public:
+	RequestFrame(const ClientID& cid, const ClientRequestCode code);
+
+	void addUint8(const uint8_t value);
+	void addUint16(const uint16_t value);
+	void addUint32(const uint32_t value);
+	void addUint64(const uint64_t value);
+	void addBytes(const uint8_t* const bytes, const size_t size);
+	bool addName(const std::string& name);
+	void setContentSize(const size_t size);
+
+	const uint8_t* data() const { return buffer.data(); }
+	size_t size() const { return buffer.size(); }
+
+private:
+	PooledBuffer buffer;			// Header and payload fields.
+	size_t content_size;			// Bytes that follow the frame (file content) and counted in the payload size.
+
+	void updatePayloadSize();
+};
+
+/* Protocol v5 response frame: the response header and exactly payloadSize bytes of payload, which are read field by field. */
+class ResponseFrame
+{
+public:
+	ResponseFrame() : offset(0) {}
+
+	ResponseHeader header;
+	PooledBuffer payload;
+
+	bool getUint8(uint8_t& value);
+	bool getUint16(uint16_t& value);
+	bool getUint32(uint32_t& value);
+	bool getUint64(uint64_t& value);
+	bool getBytes(uint8_t* const bytes, const size_t size);
+	bool getName(std::string& name);
+	bool getClientID(ClientID& cid) { return getBytes(cid.client_id, sizeof(cid.client_id)); }
+
+	void reset();
+	size_t remaining() const { return payload.size() - offset; }
+	const uint8_t* current() const { return payload.data() + offset; }
+
+private:
+	size_t offset;					// Read position in the payload.
+};
@@ -16,6 +16,16 @@ enum ClientRequestCode{
 	REQUEST_VALID_CRC = 1104,				//CRC is valid
 	REQUEST_INVALID_CRC = 1105,				//Invalid CRC, may try to send the file again.
 	REQUEST_FINAL_INVALID_CRC = 1106,
+	REQUEST_QUERY_CHUNKS = 1107,			//Which of the chunks the server does not have.
+	REQUEST_SEND_CHUNK = 1108,				//One chunk of a file, no response.
+	REQUEST_SEND_CHUNKED_FILE = 1109,		//File made of chunks the server has.
+	REQUEST_SEND_FILE_GCM = 1110,			//Send file, encrypted by AES-GCM records.
+	REQUEST_SEND_CHUNK_GCM = 1111,			//Send chunk, encrypted by AES-GCM.
+	REQUEST_COMMIT_FILE_GCM = 1112,			//Send file GCM and its CRC, the server verifies it, no valid CRC request.
+	REQUEST_COMMIT_CHUNKED_FILE = 1113,		//Send chunked file and its CRC, the server verifies it, no valid CRC request.
+	REQUEST_COMMIT_COMPRESSED_FILE_GCM = 1114,	//Commit file GCM, the file may be compressed before the encryption.
+	REQUEST_SEND_COMPRESSED_CHUNK_GCM = 1115,	//Send chunk GCM, the chunk may be compressed before the encryption.
+	REQUEST_RESUME_SESSION = 1116,			//Session ticket instead of reconnection, the new key is derived without RSA.
 };
 
 
@@ -29,7 +39,18 @@ enum ServerResponseCode{
 	RESPONSE_MESSAGE_DELIVERED = 2104,
 	RESPONSE_RECONNECTION_ACCEPTED = 2105,		
 	RESPONSE_RECONNECTION_DENIED = 2106,
-	RESPONSE_SERVER_ERROR = 2107				//Server error
+	RESPONSE_SERVER_ERROR = 2107,				//Server error
+	RESPONSE_CHUNKS_MISSING = 2108,				//Chunks of the query the server does not have
+	RESPONSE_FILE_COMMITTED = 2109,				//File stored and verified by the CRC of the commit request
+	RESPONSE_SESSION_RESUMED = 2110				//Session ticket accepted, nonce of the server and the next ticket
+};
+
+
+// Compression of the content before its encryption, chosen by the client for every file and chunk.
+enum ContentCompression : uint8_t {
+
+	COMPRESSION_NONE = 0,
+	COMPRESSION_ZLIB = 1						//zlib format (deflate)
 };
 
 
@@ -44,9 +65,22 @@ constexpr size_t	NAME_SIZE = 255;			// Client name / File name
 constexpr size_t    PUBLIC_KEY_SIZE = 160;		// In the protocol 1024 bits
 constexpr size_t    SYMETRIC_KEY_SIZE = 16;		// In The protocol 128 bits  
 
-constexpr uint8_t	CLIENT_VERSION = 3;			// Client version
-constexpr size_t	CONTENT_SIZE = 4;			// What is the size of the file that the user wants to send.
+constexpr uint8_t	CLIENT_VERSION = 6;			// Client version, protocol v6: v5 (exact length frames, 64-bit sizes) with session tickets
+constexpr size_t	CONTENT_SIZE = 8;			// What is the size of the file that the user wants to send.
 constexpr size_t	CRC_CKSUM_SIZE = 4;			// Check sum value size
+constexpr size_t	COMPRESSION_SIZE = 1;		// Compression of the content, 1 byte
+constexpr size_t	CHUNK_HASH_SIZE = 32;		// SHA-256 of the chunk content
+constexpr size_t	MAX_QUERY_CHUNKS = 1024;	// Chunk hashes in one query chunks request
+constexpr size_t	MAX_FILE_CHUNKS = 2 * 1024 * 1024;		// Chunks of a chunked file, 128 GB in chunks of 64 KB on average
+constexpr size_t	MAX_RESPONSE_PAYLOAD_SIZE = 64 * 1024 + MAX_FILE_CHUNKS / 8;	// Chunks missing of a whole file, protects from a corrupted size.
+constexpr size_t	GCM_NONCE_SIZE = 12;		// AES-GCM nonce of a record or a chunk
+constexpr size_t	GCM_NONCE_PREFIX_SIZE = 8;	// Random part of the nonces of a file, the record index follows it
+constexpr size_t	GCM_TAG_SIZE = 16;			// Authentication tag after every record
+constexpr size_t	GCM_RECORD_SIZE = 64 * 1024;		// Plain bytes of a file record, every record is sealed on its own
+constexpr uint32_t	GCM_LAST_RECORD = 0x80000000;		// Set in the record index of the last record, a cut file is not taken as whole
+constexpr size_t	TICKET_SIZE = 68;			// Session ticket, sealed by the server, the client keeps it as it is
+constexpr size_t	RESUME_NONCE_SIZE = 16;		// Nonces of the client and the server the resumed key is derived from
+constexpr int64_t	TICKET_LIFETIME = 24 * 60 * 60;		// Seconds from the key exchange or reconnection, resumption keeps the time
 
 #pragma pack(push, 1)
 
@@ -72,13 +106,6 @@ struct ClientID{
 
 };
 
-// Name structure.
-struct Name
-{
-	uint8_t name[NAME_SIZE];  
-	Name() : name{ "" } {}	//Nameless - we can change to something nice / default value.
-};
-
 // Public key structure
 struct PublicKey
 {
@@ -100,7 +127,7 @@ struct RequestHeader{
 	ClientID		cid;
 	const uint8_t	version;		// 1 byte
 	const uint16_t  code;			// 2 bytes
-	uint32_t        payloadSize;	// 4 bytes
+	uint64_t        payloadSize;	// 8 bytes
 	RequestHeader(const uint16_t reqCode) : version(CLIENT_VERSION), code(reqCode), payloadSize(0) {}
 	RequestHeader(const ClientID& id, const uint16_t reqCode) : cid(id), version(CLIENT_VERSION), code(reqCode), payloadSize(0) {}
 };
@@ -114,146 +141,47 @@ struct ResponseHeader{
 };
 
 
-// =============================  Types of requests ===================================
-
-struct RegistrationRequest {
-
-	RequestHeader req_header;
-	
-	struct {
-		Name client_name;
-	}payload;
-	RegistrationRequest() : req_header(REQUEST_REGISTRATION) {}
-};
-
-struct SendPublicKeyRequest {
-
-	RequestHeader req_header;
-
-	struct {
-		Name client_name;
-		PublicKey key_pub;
-	}payload;
-	SendPublicKeyRequest() : req_header(REQUEST_SEND_PUBLIC_KEY) {}
-};
-
-struct ReconnectionRequest {
-
-	RequestHeader req_header;
-
-	struct {
-		Name client_name;
-	}payload;
-	ReconnectionRequest() : req_header(REQUEST_RECONNECT) {}
-};
-
-struct SendFileRequest {
-
-	RequestHeader req_header;
-
-	struct {
-		uint32_t contentSize;
-		Name file_name;
-		
-		//Message content is sent and not used in the struct.
-	}payload;
-	SendFileRequest() : req_header(REQUEST_SEND_FILE) {}
-};
-
-struct ValidCrcRequest {
-
-	RequestHeader req_header;
-
-	struct {
-		Name file_name;
-	}payload;
-	ValidCrcRequest() : req_header(REQUEST_VALID_CRC) {}
-};
-
-
-struct InvalidCrcRequest {
-
-	RequestHeader req_header;
-
-	struct {
-		Name file_name;
-	}payload;
-	InvalidCrcRequest() : req_header(REQUEST_INVALID_CRC) {}
-};
-
-struct FinalInvalidCrcRequest {
-
-	RequestHeader req_header;
-
-	struct {
-		Name file_name;
-	}payload;
-	FinalInvalidCrcRequest() : req_header(REQUEST_FINAL_INVALID_CRC) {}
-};
-
-
-// =============================  Types of responses ===================================
-
-struct RegistrationSuccessResponse {
-
-	ResponseHeader res_header;
-	ClientID cid;
-};
-
-
-struct RegistrationFailResponse {
-
-	ResponseHeader res_header;
-};
-
-
-struct SendPublicKeyResponse {		// got public key, sending back AES key
-
-	ResponseHeader res_header;
-
-	struct 
-	{
-		ClientID cid;
-		uint8_t encrypted_sym_key[PUBLIC_KEY_SIZE]; 		//encrypted symetric key that we get from the server
-	}payload;
-};
-
-
-struct SendFileResponse {
-
-	ResponseHeader res_header;
-	
-	struct {
-		ClientID cid;
-		uint32_t ContentSize;		// 4 bytes
-		Name file_name;
-		uint32_t calculated_crc;	// 4 bytes
-	}payload;
-};
-
-struct MessageDeliveredResponse {
-
-	ResponseHeader res_header;
-	ClientID cid;
-};
-
-struct ReconectionApprovedResponse {
-
-	ResponseHeader res_header;
-	struct {
-		ClientID cid;
-		uint8_t encrypted_sym_key[PUBLIC_KEY_SIZE];		// new encrypted symetric key.
-	}payload;
-};
-
-struct ReconectionDeniedResponse {
-
-	ResponseHeader res_header;
-	ClientID cid;
-};
-
-struct GlobalErrorResponse {
-	ResponseHeader res_header;
-};
+// =============================  Protocol v6 payloads ===================================
+//
+// Every request and response is the header and exactly payloadSize bytes after it. Name is 1 byte length and the name bytes.
+// v5 is v4 with 64-bit sizes: payloadSize of the request header and the sizes of the files and the contents below are uint64 (uint32 in
+// v4). Payload size of the response header stays uint32, responses are small.
+// v6 is v5 with session tickets: key exchange and reconnection accepted responses end with a ticket of the new key, resume session
+// presents it instead of a reconnection. New key is the first 16 bytes of HMAC-SHA256 (key: the key of the ticket) of
+// "session resumption", nonce of the client and nonce of the server.
+//
+// Requests:
+//	Registration		Name
+//	Send public key		Name, PublicKey
+//	Reconnect			Name
+//	Send file			uint64 content size, Name (file name), encrypted content
+//	Valid CRC			Name (file name)
+//	Invalid CRC			Name (file name)
+//	Final invalid CRC	Name (file name)
+//	Query chunks		uint32 count, count chunk hashes
+//	Send chunk			uint64 content size, encrypted chunk (padded on its own)
+//	Send chunked file	uint64 file size, Name (file name), uint32 count, count chunk hashes (in the order of the file)
+//	Send file GCM		uint64 content size, Name (file name), nonce prefix, records (encrypted record and its tag), record nonce is
+//						the prefix and uint32 record index (GCM_LAST_RECORD set for the last record)
+//	Send chunk GCM		uint64 content size, nonce, encrypted chunk, tag
+//	Commit file GCM		as send file GCM and uint32 CRC of the file after the content (counted in the payload, not in the content size)
+//	Commit chunked file	as send chunked file and uint32 CRC of the file
+//	Commit compressed file GCM	uint64 content size, Name (file name), uint8 compression, uint64 file size, content as commit file GCM
+//						(records of the compressed file), uint32 CRC of the file
+//	Send compressed chunk GCM	uint64 content size, uint8 compression, content as send chunk GCM (of the compressed chunk)
+//	Resume session		nonce (RESUME_NONCE_SIZE), ticket (TICKET_SIZE)
+//
+// Responses:
+//	Registration success		ClientID
+//	Registration failure		-
+//	Key exchange				ClientID, encrypted symetric key, ticket (TICKET_SIZE, the end of the payload)
+//	File delivered with CRC		ClientID, uint64 content size, Name (file name), uint32 CRC
+//	Message delivered			ClientID
+//	Reconnection accepted		ClientID, encrypted symetric key, ticket (TICKET_SIZE, the end of the payload)
+//	Reconnection denied			ClientID (also the answer to a ticket that is not valid or expired)
+//	Server error				-
+//	Chunks missing				ClientID, uint32 count, bitmap of the query hashes (bit set if missing, least significant bit first)
+//	File committed				as file delivered with CRC, the CRC of the request was the same and the file is verified
+//	Session resumed				ClientID, nonce (RESUME_NONCE_SIZE), ticket of the new key (TICKET_SIZE)
 
 #pragma pack(pop)
\ No newline at end of file
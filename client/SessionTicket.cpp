@@ -0,0 +1,123 @@
+#include "SessionTicket.h"
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cstring>
+#include <hmac.h>
+#include <sha.h>
+#include "Utils.h"
+
+constexpr auto KEY_LABEL = "session resumption";	// Derivation of the resumed symmetric key, the same label as the server.
+
+SessionTicket::SessionTicket(const std::string& ticket_path) : ticket_path(ticket_path), ticket{ 0 }, expiry_time(0), present(false)
+{
+}
+
+SessionTicket::~SessionTicket()
+{
+}
+
+/*  The function loads the ticket from the disk: the owner, the ticket and the resumption secret (hex) and the expiry time, every one on a
+	line. A ticket of another owner is not loaded. Returns false if there is no ticket of the owner. */
+bool SessionTicket::load(const std::string& ticket_owner)
+{
+	owner = ticket_owner;
+	present = false;
+
+	std::ifstream file(ticket_path);
+	if (!file)
+		return false;
+
+	std::string line, ticketHex, secretHex;
+	if (!std::getline(file, line) || line != owner || !std::getline(file, ticketHex) || !std::getline(file, secretHex) ||
+		!(file >> expiry_time))
+		return false;
+
+	const std::string ticketBytes = Utils::unhex(ticketHex);
+	const std::string secretBytes = Utils::unhex(secretHex);
+	if (ticketBytes.size() != TICKET_SIZE || secretBytes.size() != SYMETRIC_KEY_SIZE)
+		return false;		// Damaged file, the session is reconnected with RSA.
+
+	memcpy(ticket, ticketBytes.data(), TICKET_SIZE);
+	memcpy(resumption_secret.symetricKey, secretBytes.data(), SYMETRIC_KEY_SIZE);
+	present = true;
+	return true;
+}
+
+/*  The function writes the ticket to the disk, the file is written to a temporary file first and renamed, so an interrupted run does not
+	leave a damaged ticket. Without a ticket the file is removed. Returns true if succseed and false otherwise. */
+bool SessionTicket::save() const
+{
+	std::error_code errorCode;		// without this the filesystem functions will throw exception.
+	if (!present) {
+		std::filesystem::remove(ticket_path, errorCode);
+		return !errorCode;
+	}
+
+	const std::string tempPath = ticket_path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::trunc);
+		if (!file) {
+			std::cout << "Error: Failed to open: " << tempPath << ", tried to save the session ticket." << std::endl;
+			return false;
+		}
+		file << owner << '\n' << Utils::hex(ticket, TICKET_SIZE) << '\n'
+			<< Utils::hex(resumption_secret.symetricKey, SYMETRIC_KEY_SIZE) << '\n' << expiry_time << '\n';
+		if (!file.flush()) {
+			std::cout << "Error: Failed to write the session ticket into " << tempPath << std::endl;
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, ticket_path, errorCode);
+	if (errorCode) {
+		std::cout << "Error: Failed to replace " << ticket_path << ": " << errorCode.message() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+/* The function sets the ticket the server issued for the secret, the owner is the client and the server it was issued by. */
+void SessionTicket::set(const std::string& ticket_owner, const uint8_t* const ticket_bytes, const SymetricKey& secret, const int64_t expires)
+{
+	owner = ticket_owner;
+	memcpy(ticket, ticket_bytes, TICKET_SIZE);
+	resumption_secret = secret;
+	expiry_time = expires;
+	present = true;
+}
+
+/* The function drops the ticket, the server did not accept it. */
+void SessionTicket::clear()
+{
+	present = false;
+}
+
+/* The function checks if there is a ticket that is worth presenting, the server does not accept an expired one. */
+bool SessionTicket::valid() const
+{
+	return present && now() < expiry_time;
+}
+
+/*  The function derives the symmetric key of the resumed session: HMAC-SHA256 of the label and the nonces of the client and the server
+	by the resumption secret, the first SYMETRIC_KEY_SIZE bytes. */
+SymetricKey SessionTicket::deriveKey(const SymetricKey& secret, const uint8_t* const client_nonce, const uint8_t* const server_nonce)
+{
+	CryptoPP::HMAC<CryptoPP::SHA256> hmac(secret.symetricKey, SYMETRIC_KEY_SIZE);
+	hmac.Update(reinterpret_cast<const CryptoPP::byte*>(KEY_LABEL), strlen(KEY_LABEL));
+	hmac.Update(client_nonce, RESUME_NONCE_SIZE);
+	hmac.Update(server_nonce, RESUME_NONCE_SIZE);
+	CryptoPP::byte digest[CryptoPP::HMAC<CryptoPP::SHA256>::DIGESTSIZE];
+	hmac.Final(digest);
+
+	SymetricKey key;
+	memcpy(key.symetricKey, digest, SYMETRIC_KEY_SIZE);
+	return key;
+}
+
+/* The function returns the current time in seconds since the epoch, as the issue time of the server. */
+int64_t SessionTicket::now()
+{
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
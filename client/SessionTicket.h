@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "Request.h"
+
+constexpr auto TICKET_INFO = "ticket.info";
+
+/*  Session ticket of the last symmetric key, issued by the server with every key exchange, reconnection and resumption. The ticket is
+	sealed by the server, the client keeps it as it is with its resumption secret (the symmetric key it was issued with) and presents it
+	to resume the session: the next symmetric key is derived from the secret, without RSA on both sides. The ticket is kept on the disk
+	between runs and belongs to one owner (client at a server), the ticket of another owner is not used. */
+class SessionTicket
+{
+public:
+	SessionTicket(const std::string& ticket_path = TICKET_INFO);
+	virtual ~SessionTicket();
+
+	bool load(const std::string& ticket_owner);
+	bool save() const;
+	void set(const std::string& ticket_owner, const uint8_t* const ticket_bytes, const SymetricKey& secret, const int64_t expires);
+	void clear();
+	bool valid() const;
+
+	const uint8_t* data() const { return ticket; }
+	const SymetricKey& secret() const { return resumption_secret; }
+	int64_t expiry() const { return expiry_time; }
+
+	static SymetricKey deriveKey(const SymetricKey& secret, const uint8_t* const client_nonce, const uint8_t* const server_nonce);
+	static int64_t now();
+
+private:
+	std::string ticket_path;
+	std::string owner;
+	uint8_t ticket[TICKET_SIZE];
+	SymetricKey resumption_secret;
+	int64_t expiry_time;			// Seconds since the epoch, the server does not accept the ticket after it.
+	bool present;
+};
@@ -1,12 +1,12 @@
-
 #include "SocketManager.h"
 #include <iostream>
 #include <boost/asio.hpp>
 
 using boost::asio::ip::tcp;
-using boost::asio::io_context;
+using boost::asio::use_awaitable;
+using boost::asio::redirect_error;
 
-SocketManager::SocketManager():io_context(nullptr), resolver(nullptr), socket(nullptr), connected(false)	//TODO: Maybe need to setup all default opptions for variables.
+SocketManager::SocketManager(const boost::asio::any_io_executor& executor) : resolver(executor), socket(executor), connected(false)
 {
 }
 
@@ -17,121 +17,89 @@ SocketManager::~SocketManager()
 
 /* The function sets port and destination address for the socket. */
 bool SocketManager::setSocket(const std::string& address, const std::string& port)
-{ 
+{
 	socket_address = address;
 	socket_port = port;
+	endpoints = tcp::resolver::results_type();		// resolve the new address on the next connect.
 	return true;
 }
 
-/* The function attempts to connect to a TCP server, returns true if succseed, and false otherwise */
-bool SocketManager::connect() {
-	try {
-		close();				// in case that there is an open socket.		
-		io_context = new boost::asio::io_context;
-		socket = new tcp::socket(*io_context);
-		resolver = new tcp::resolver(*io_context);
-
-		// Setup connection
-		boost::asio::connect(*socket, resolver->resolve(socket_address, socket_port));
-		socket->non_blocking(false);
-		connected = true;
+/*  The function attempts to connect to a TCP server, returns true if succseed, and false otherwise. The resolver and the resolved
+	address are kept between connections, only the socket is opened again. */
+awaitable<bool> SocketManager::connect() {
+	close();				// in case that there is an open socket.
+
+	boost::system::error_code errorCode;
+	if (endpoints.empty()) {
+		endpoints = co_await resolver.async_resolve(socket_address, socket_port, redirect_error(use_awaitable, errorCode));
 	}
-	catch (...) {
-		connected = false;		// Something went wrong 
+	if (!errorCode) {
+		co_await boost::asio::async_connect(socket, endpoints, redirect_error(use_awaitable, errorCode));
 	}
-	return connected;
+
+	connected = !errorCode;
+	if (!connected) {
+		close();		// Something went wrong
+		endpoints = tcp::resolver::results_type();
+	}
+	co_return connected;
 }
 
 /* The function closes open socket connection */
 void SocketManager::close()
 {
-	if (socket != nullptr) {
-		try {
-			socket->shutdown(boost::asio::socket_base::shutdown_both);
-			socket->close();
-		}
-		catch (...) {
-			// handle any exceptions thrown by shutdown() or close()
-		}
-		delete socket;
-		socket = nullptr;
-	}
-
-	if (resolver != nullptr) {
-		delete resolver;
-		resolver = nullptr;
-	}
-
-	if (io_context != nullptr) {
-		delete io_context;
-		io_context = nullptr;
+	if (socket.is_open()) {
+		boost::system::error_code errorCode;		// errors of shutdown() or close() are ignored.
+		socket.shutdown(boost::asio::socket_base::shutdown_both, errorCode);
+		socket.close(errorCode);
 	}
 
 	connected = false;
 }
 
-/*  This function sends a request over an open socket connection. It takes a buffer of bytes to send and the size of the buffer.
-	The function splits the buffer into smaller packets of a fixed size, and sends each packet over the socket.
-	The function returns true if the request was sent successfully, and false otherwise.
+/*  This function sends the buffer as is over an open socket connection. Used for streaming where the data is produced in parts,
+	so the receiving side sees one continuous byte stream. The function returns true if all the bytes were sent, and false otherwise.
 */
-bool SocketManager::sendRequest(const uint8_t* const buffer, const size_t size) const
+awaitable<bool> SocketManager::send(const uint8_t* const buffer, const size_t size)
 {
-	if (buffer == nullptr || socket == nullptr || size == 0)	
-		return false;
+	if (buffer == nullptr || !connected || size == 0)
+		co_return false;
 
-	size_t bytesToSend = size;
-	const uint8_t* ptr = buffer;
+	boost::system::error_code errorCode; // without this async_write() will throw exception.
+	const size_t bytesWritten = co_await async_write(socket, boost::asio::buffer(buffer, size), redirect_error(use_awaitable, errorCode));
 
-	while (bytesToSend > 0)
-	{
-		boost::system::error_code errorCode; // without this write() will throw exception.
-		uint8_t tempBuffer[PACKET_SIZE] = { 0 };
-		const size_t bytes_in_packet = (bytesToSend > PACKET_SIZE) ?  PACKET_SIZE : bytesToSend;	//Send no more then PACKET_SIZE
-
-		memcpy(tempBuffer, ptr, bytes_in_packet);
+	co_return !errorCode && bytesWritten == size;
+}
 
-		const size_t bytesWritten = write(*socket, boost::asio::buffer(tempBuffer, PACKET_SIZE), errorCode);
+/* This function receives exactly size bytes into the buffer over an open socket connection. Returns true if the buffer was filled. */
+awaitable<bool> SocketManager::receive(uint8_t* const buffer, const size_t size)
+{
+	if (buffer == nullptr || size == 0)
+		co_return false;
 
-		if (bytesWritten == 0)
-			return false;
+	co_return co_await receive(boost::asio::buffer(buffer, size));
+}
 
-		ptr += bytesWritten;
-		if (bytesWritten > bytesToSend) {	// packet is bigget then the amout of bytes left to send.
-			bytesToSend = 0;				
-		}
-		else {								// need another packet
-			bytesToSend = bytesToSend - bytesWritten;
-		}
-	}
-	return true;
+/* This function sends protocol v5 request frame, the frame is sent as is, without padding. */
+awaitable<bool> SocketManager::sendFrame(const RequestFrame& frame)
+{
+	co_return co_await send(frame.data(), frame.size());
 }
 
-/*  This function receives a response over an open socket connection, takes a buffer to store the received bytes and the size of the buffer.
-	The function receives data from the socket in smaller packets of a fixed size, and appends the data to the buffer until the desired amount
-	of data has been received. The function returns true if the response was received successfully, and false otherwise.
-*/
-bool SocketManager::receiveResponse(uint8_t* const buffer, const size_t size) const
+/*  This function receives protocol v5 response frame: the header first and then exactly payloadSize bytes of the payload.
+	The function returns false if the response could not be received or the payload size is not reasonable. */
+awaitable<bool> SocketManager::receiveFrame(ResponseFrame& frame)
 {
-	if (buffer == nullptr || socket == nullptr || size == 0){
-		return false;
-	}
-	
-	size_t bytesToRecieve = size;
-	uint8_t* ptr = buffer;
-
-	while (bytesToRecieve > 0)
-	{
-		uint8_t tempBuffer[PACKET_SIZE] = { 0 };
-		boost::system::error_code errorCode; // without this read() will throw exception.
-		size_t bytesRead = read(*socket, boost::asio::buffer(tempBuffer, PACKET_SIZE), errorCode);
-
-		if (bytesRead == 0) {
-			return false;     // Failed receiving.
-		}
-		const size_t bytesToCopy = (bytesToRecieve > bytesRead) ? bytesRead : bytesToRecieve;  // prevent buffer overflow.
-		memcpy(ptr, tempBuffer, bytesToCopy);
-		ptr += bytesToCopy;
-		bytesToRecieve = (bytesToRecieve < bytesToCopy) ? 0 : (bytesToRecieve - bytesToCopy);  // unsigned protection.
-	}
-	return true;
-}
\ No newline at end of file
+	frame.reset();		// frame may be reused, start reading the new payload from its beginning.
+	const bool received = co_await receive(reinterpret_cast<uint8_t*>(&frame.header), sizeof(frame.header));
+	if (!received)
+		co_return false;
+
+	if (frame.header.payloadSize > MAX_RESPONSE_PAYLOAD_SIZE)
+		co_return false;
+
+	frame.payload.resize(frame.header.payloadSize);
+	if (frame.payload.empty())
+		co_return true;
+	co_return co_await receive(frame.payload.data(), frame.payload.size());
+}
@@ -1,33 +1,79 @@
 #pragma once
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include "Frame.h"
 
-using boost::asio::io_context;
+using boost::asio::awaitable;
 using boost::asio::ip::tcp;
 
-constexpr size_t PACKET_SIZE = 1024;		// Fixed packet size
-
+/*  Connection to the server. All the operations are asynchronous (coroutines), they are awaited by the session that owns the
+	connection and the io context goes on with the other sessions meanwhile. */
 class SocketManager
 {
 public:
 	// Constructors & Destroctors
-	SocketManager();
+	SocketManager(const boost::asio::any_io_executor& executor);
 	virtual ~SocketManager();
 
 	// Functions
 	void close();	//Used in the destructor.
 	bool setSocket(const std::string& address, const std::string& port);
-	bool connect();
-	bool sendRequest(const uint8_t* const buffer, const size_t size) const;
-	bool receiveResponse(uint8_t* const buffer, const size_t size) const;
-	
+	const std::string& address() const { return socket_address; }
+	const std::string& port() const { return socket_port; }
+	awaitable<bool> connect();
+	bool isConnected() const { return connected; }
+	awaitable<bool> send(const uint8_t* const buffer, const size_t size);
+	awaitable<bool> receive(uint8_t* const buffer, const size_t size);
+	template <typename ConstBufferSequence>
+	awaitable<bool> send(const ConstBufferSequence& buffers);
+	template <typename MutableBufferSequence>
+	awaitable<bool> receive(const MutableBufferSequence& buffers);
+	awaitable<bool> sendFrame(const RequestFrame& frame);
+	awaitable<bool> receiveFrame(ResponseFrame& frame);
+
 
 private:
 
-	io_context*					io_context;
-	tcp::resolver*				resolver;
-	tcp::socket*				socket;
+	tcp::resolver				resolver;
+	tcp::socket					socket;
+	tcp::resolver::results_type	endpoints;		// Resolved server address, kept between connections.
 	std::string					socket_address;
 	std::string					socket_port;
 	bool						connected;
 
-};
\ No newline at end of file
+};
+
+/*  This function sends a sequence of buffers (for example header, payload and trailer) over an open socket connection in one gather write,
+	the buffers are handed to the socket as they are, without being copied or joined. Returns true if all the bytes were sent. */
+template <typename ConstBufferSequence>
+awaitable<bool> SocketManager::send(const ConstBufferSequence& buffers)
+{
+	if (!connected || boost::asio::buffer_size(buffers) == 0)
+		co_return false;
+
+	boost::system::error_code errorCode; // without this async_write() will throw exception.
+	const size_t bytesWritten = co_await boost::asio::async_write(socket, buffers,
+		boost::asio::redirect_error(boost::asio::use_awaitable, errorCode));
+
+	co_return !errorCode && bytesWritten == boost::asio::buffer_size(buffers);
+}
+
+/*  This function receives into a sequence of buffers over an open socket connection in one scatter read, every buffer is filled in
+	its turn straight from the socket. Returns true if all the buffers were filled. */
+template <typename MutableBufferSequence>
+awaitable<bool> SocketManager::receive(const MutableBufferSequence& buffers)
+{
+	if (!connected || boost::asio::buffer_size(buffers) == 0)
+		co_return false;
+
+	boost::system::error_code errorCode; // without this async_read() will throw exception.
+	const size_t bytesRead = co_await boost::asio::async_read(socket, buffers,
+		boost::asio::redirect_error(boost::asio::use_awaitable, errorCode));
+
+	co_return !errorCode && bytesRead == boost::asio::buffer_size(buffers);
+}
@@ -0,0 +1,55 @@
+#include "TransferEngine.h"
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+
+TransferEngine::TransferEngine(const size_t worker_threads) : worker_pool(worker_threads == 0 ? 1 : worker_threads)
+{
+}
+
+TransferEngine::~TransferEngine()
+{
+	worker_pool.join();
+}
+
+/* The function runs the engine on the calling thread until all the started operations are finished. */
+void TransferEngine::run()
+{
+	io_context.restart();		// The context stops when it runs out of work, restart it for the next operations.
+	io_context.run();
+}
+
+BackgroundWork::BackgroundWork(TransferEngine& engine) : engine(engine), done_signal(engine.context()), done(true), result(false)
+{
+}
+
+/* The function starts the work on the worker threads, its result is passed back to the io thread. Work that throws
+   (crypto errors, out of memory) fails, the waiting coroutine is woken up in any case. */
+void BackgroundWork::start(std::function<bool()> work)
+{
+	done = false;
+	done_signal.expires_at(boost::asio::steady_timer::time_point::max());
+	boost::asio::post(engine.workers(), [this, work]() {
+		bool workResult = false;
+		try {
+			workResult = work();
+		}
+		catch (...) {
+			workResult = false;
+		}
+		boost::asio::post(engine.context(), [this, workResult]() {
+			result = workResult;
+			done = true;
+			done_signal.cancel();
+		});
+	});
+}
+
+/* The function waits until the work is done and returns its result. */
+awaitable<bool> BackgroundWork::wait()
+{
+	if (!done) {
+		boost::system::error_code errorCode;		// Canceled timer is the signal, not an error.
+		co_await done_signal.async_wait(boost::asio::redirect_error(boost::asio::use_awaitable, errorCode));
+	}
+	co_return result;
+}
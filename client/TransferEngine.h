@@ -0,0 +1,70 @@
+#pragma once
+#include <functional>
+#include <exception>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+using boost::asio::awaitable;
+
+/*  Asynchronous transfer engine. All the sessions (one Client object each) run as coroutines on one io context, so one thread drives
+	many transfers at once: while one session waits for the network the others go on. File reading, CRC and encryption are not done on
+	the io thread, they are handed to the worker threads of the engine so they overlap with the network I/O.
+	The io context is run by one thread only, the coroutines of the engine do not need locking between them. */
+class TransferEngine
+{
+public:
+	TransferEngine(const size_t worker_threads = DEFAULT_WORKER_THREADS);
+	virtual ~TransferEngine();
+
+	static constexpr size_t DEFAULT_WORKER_THREADS = 2;
+
+	boost::asio::io_context& context() { return io_context; }
+	boost::asio::thread_pool& workers() { return worker_pool; }
+
+	/* The function starts an operation (session) on the engine, it runs when the engine runs. The handler is called with the result. */
+	template <typename T>
+	void spawn(awaitable<T> operation, std::function<void(T)> handler) {
+		boost::asio::co_spawn(io_context, std::move(operation), [handler](std::exception_ptr error, T result) {
+			if (error)
+				result = T();		// Operation failed with exception, the default value (false / 0) is the failure value.
+			handler(result);
+		});
+	}
+
+	/* The function runs the engine on the calling thread until all the started operations are finished. */
+	void run();
+
+	/* The function runs one operation to the end and returns its result, used by the synchronous functions of the Client. */
+	template <typename T>
+	T runOne(awaitable<T> operation) {
+		T operationResult = T();
+		spawn<T>(std::move(operation), [&operationResult](T result) { operationResult = result; });
+		run();
+		return operationResult;
+	}
+
+private:
+	boost::asio::io_context		io_context;		// Network I/O of all the sessions.
+	boost::asio::thread_pool	worker_pool;	// File reading, CRC and encryption.
+};
+
+/*  Work that runs on the worker threads of the engine while the coroutine that started it goes on with other things (usualy writes to
+	the socket), the coroutine awaits the result later. The work must be awaited before the things it uses are destroyed. */
+class BackgroundWork
+{
+public:
+	BackgroundWork(TransferEngine& engine);
+
+	void start(std::function<bool()> work);
+	awaitable<bool> wait();
+
+private:
+	TransferEngine& engine;
+	boost::asio::steady_timer done_signal;		// Canceled when the work is done, the waiting coroutine wakes up.
+	bool done;
+	bool result;
+};
@@ -3,6 +3,7 @@
 #include <boost/algorithm/hex.hpp>
 #include <boost/algorithm/string/trim.hpp>
 #include <fstream>
+#include <filesystem>
 #include <base64.h>
 #include <iostream>
 
@@ -102,3 +103,55 @@ bool Utils::isValidFilePath(const std::string path) {
 	std::ifstream file(path.c_str());
 	return file.good();
 }
+
+/* This function checks if the path is a pattern (contains * or ? wildcards) rather than a name of one file. */
+bool Utils::isPattern(const std::string& path) {
+	return path.find_first_of("*?") != std::string::npos;
+}
+
+/* This function checks if the name matches the pattern, * matches any sequence of characters and ? matches one character. */
+bool Utils::matchesPattern(const std::string& name, const std::string& pattern) {
+	size_t n = 0, p = 0;
+	size_t starPos = std::string::npos, starMatch = 0;		// Last * in the pattern and the name position it matched up to.
+
+	while (n < name.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+			n++;
+			p++;
+		}
+		else if (p < pattern.size() && pattern[p] == '*') {
+			starPos = p++;
+			starMatch = n;
+		}
+		else if (starPos != std::string::npos) {		// Let the last * match one more character.
+			p = starPos + 1;
+			n = ++starMatch;
+		}
+		else {
+			return false;
+		}
+	}
+	while (p < pattern.size() && pattern[p] == '*')
+		p++;
+	return p == pattern.size();
+}
+
+/*  This function returns the regular files that match the pattern, sorted by name. The wildcards are allowed in the file name only,
+	the directory part of the pattern is taken as is. */
+std::vector<std::string> Utils::expandPattern(const std::string& pattern) {
+	std::vector<std::string> files;
+
+	const size_t separatorPos = pattern.find_last_of("/\\");
+	const std::string directory = separatorPos == std::string::npos ? "" : pattern.substr(0, separatorPos + 1);
+	const std::string namePattern = pattern.substr(directory.size());
+
+	std::error_code errorCode;		// without this directory_iterator will throw exception.
+	for (const auto& entry : std::filesystem::directory_iterator(directory.empty() ? "." : directory, errorCode)) {
+		const std::string name = entry.path().filename().string();
+		if (entry.is_regular_file(errorCode) && matchesPattern(name, namePattern))
+			files.push_back(directory + name);
+	}
+
+	std::sort(files.begin(), files.end());
+	return files;
+}
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <iostream>
 #include <bitset>
+#include <vector>
 
 class Utils
 {
@@ -17,4 +18,7 @@ public:
 	static std::string hex_to_string(const std::string& hex);
 	static std::string stringToHex(const std::string& input);
 	static bool isValidFilePath(const std::string path);
+	static bool isPattern(const std::string& path);
+	static bool matchesPattern(const std::string& name, const std::string& pattern);
+	static std::vector<std::string> expandPattern(const std::string& pattern);
 };
\ No newline at end of file
@@ -0,0 +1,143 @@
+/*  Benchmark of the CRC-32 engine against boost::crc_32_type, the CRC the client used before.
+	In memory: the kernels over the given size (a 1 MB buffer processed again and again). Files: the old FileManager::calculate_crc loop
+	(Boost, 4 KB reads) against calculate_crc on one thread and on all the cores (segments combined).
+	Build it together with the client sources, without client/main.cpp.
+	Usage: Crc32Benchmark [size in MB]...	(default: 1 100 4096, the files are written to the current folder)
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <boost/crc.hpp>
+#include "../FileManager.h"
+#include "../Crc32.h"
+
+constexpr auto BENCH_FILE = "crc32_bench.bin";
+constexpr size_t BUFFER_SIZE = 1024 * 1024;
+constexpr int ROUNDS = 3;
+
+/* The function fills the buffer with pseudo random content. */
+static void fill(std::vector<char>& buffer, uint32_t& state)
+{
+	for (auto& c : buffer) {
+		state = state * 1664525 + 1013904223;
+		c = static_cast<char>(state >> 24);
+	}
+}
+
+/* The function creates a file with pseudo random content of the given size. */
+static bool createFile(const std::string& path, uint64_t bytes)
+{
+	std::ofstream file(path, std::ios::binary);
+	std::vector<char> block(BUFFER_SIZE);
+	uint32_t state = 0x12345678;
+	while (bytes > 0 && file) {
+		fill(block, state);
+		const size_t toWrite = (bytes > block.size()) ? block.size() : static_cast<size_t>(bytes);
+		file.write(block.data(), toWrite);
+		bytes -= toWrite;
+	}
+	return file.good();
+}
+
+/* The function runs the operation ROUNDS times and returns the best rate in MB/s, crc is set to the result of the operation. */
+static double bestRate(const uint64_t bytes, const std::function<uint32_t()>& operation, uint32_t& crc)
+{
+	double best = 0;
+	for (int round = 0; round < ROUNDS; round++) {
+		const auto start = std::chrono::steady_clock::now();
+		crc = operation();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		const double rate = bytes / elapsed.count() / (1024 * 1024);
+		if (rate > best)
+			best = rate;
+	}
+	return best;
+}
+
+/* The CRC of the file as FileManager::calculate_crc calculated it before the CRC engine. */
+static uint32_t boostFileCrc(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	boost::crc_32_type result;
+	char buffer[4096];
+	while (file.read(buffer, sizeof(buffer))) {
+		result.process_bytes(buffer, sizeof(buffer));
+	}
+	result.process_bytes(buffer, file.gcount());
+	return result.checksum();
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<uint64_t> sizes;
+	for (int i = 1; i < argc; i++)
+		sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+	if (sizes.empty())
+		sizes = { 1, 100, 4096 };
+
+	std::vector<char> buffer(BUFFER_SIZE);
+	uint32_t state = 0x9E3779B9;
+	fill(buffer, state);
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(buffer.data());
+
+	FileManager file_manager;
+	bool valid = true;
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Folding kernel (PCLMULQDQ): " << (Crc32::accelerated() ? "yes" : "no") << ", cores: "
+		<< std::thread::hardware_concurrency() << ", best of " << ROUNDS << " rounds" << std::endl;
+
+	for (const uint64_t megabytes : sizes) {
+		const uint64_t bytes = megabytes * 1024 * 1024;
+		uint32_t crcs[6] = { 0 };
+		double rates[6] = { 0 };
+
+		rates[0] = bestRate(bytes, [&]() {
+			boost::crc_32_type crc;
+			for (uint64_t i = 0; i < megabytes; i++)
+				crc.process_bytes(data, BUFFER_SIZE);
+			return crc.checksum();
+		}, crcs[0]);
+		rates[1] = bestRate(bytes, [&]() {
+			uint32_t crc = 0;
+			for (uint64_t i = 0; i < megabytes; i++)
+				crc = Crc32::computeTable(data, BUFFER_SIZE, crc);
+			return crc;
+		}, crcs[1]);
+		rates[2] = bestRate(bytes, [&]() {
+			Crc32 crc;
+			for (uint64_t i = 0; i < megabytes; i++)
+				crc.update(data, BUFFER_SIZE);
+			return crc.checksum();
+		}, crcs[2]);
+
+		if (!createFile(BENCH_FILE, bytes)) {
+			std::cout << "Error: Failed to create " << BENCH_FILE << std::endl;
+			std::remove(BENCH_FILE);
+			return 1;
+		}
+		rates[3] = bestRate(bytes, [&]() { return boostFileCrc(BENCH_FILE); }, crcs[3]);
+		rates[4] = bestRate(bytes, [&]() { return file_manager.calculate_crc(BENCH_FILE, 1); }, crcs[4]);
+		rates[5] = bestRate(bytes, [&]() { return file_manager.calculate_crc(BENCH_FILE); }, crcs[5]);
+		std::remove(BENCH_FILE);
+
+		std::cout << std::endl << "Size: " << megabytes << " MB" << std::endl;
+		std::cout << "  Memory, boost::crc_32_type:             " << std::setw(9) << rates[0] << " MB/s" << std::endl;
+		std::cout << "  Memory, Crc32 tables (slicing by 8):    " << std::setw(9) << rates[1] << " MB/s" << std::endl;
+		std::cout << "  Memory, Crc32:                          " << std::setw(9) << rates[2] << " MB/s" << std::endl;
+		std::cout << "  File, boost::crc_32_type (4 KB reads):  " << std::setw(9) << rates[3] << " MB/s" << std::endl;
+		std::cout << "  File, calculate_crc one thread:         " << std::setw(9) << rates[4] << " MB/s" << std::endl;
+		std::cout << "  File, calculate_crc all the cores:      " << std::setw(9) << rates[5] << " MB/s" << std::endl;
+
+		if (crcs[0] != crcs[1] || crcs[0] != crcs[2] || crcs[3] != crcs[4] || crcs[3] != crcs[5]) {
+			std::cout << "Error: CRC values differ." << std::endl;
+			valid = false;
+		}
+	}
+	return valid ? 0 : 1;
+}
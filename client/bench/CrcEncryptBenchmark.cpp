@@ -0,0 +1,114 @@
+/*  Benchmark of the upload preparation: the two pass path (FileManager::calculate_crc and then readFileIntoBuffer + AESWrapper::encrypt)
+	against the single pass FileEncryptor (CRC and encryption from the same chunk buffer), in CBC and in GCM mode.
+	Build it together with the client sources, without client/main.cpp.
+	Usage: CrcEncryptBenchmark [size in MB] [rounds]
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include "../FileManager.h"
+#include "../AESWrapper.h"
+#include "../FileEncryptor.h"
+
+constexpr auto BENCH_FILE = "crc_encrypt_bench.bin";
+
+/* The function creates a file with pseudo random content of the given size. */
+static bool createFile(const std::string& path, size_t bytes)
+{
+	std::ofstream file(path, std::ios::binary);
+	std::vector<char> block(FILE_CHUNK_SIZE);
+	uint32_t state = 0x12345678;
+	while (bytes > 0 && file) {
+		for (auto& c : block) {
+			state = state * 1664525 + 1013904223;
+			c = static_cast<char>(state >> 24);
+		}
+		const size_t toWrite = (bytes > block.size()) ? block.size() : bytes;
+		file.write(block.data(), toWrite);
+		bytes -= toWrite;
+	}
+	return file.good();
+}
+
+/* Two pass path: the file is read once for the CRC and once more for the encryption. */
+static uint32_t twoPass(FileManager& file_manager, const AESWrapper& aes, const std::string& path, size_t& cipherBytes)
+{
+	const uint32_t crc = file_manager.calculate_crc(path);
+	uint8_t* file = nullptr;
+	size_t bytes = 0;
+	cipherBytes = 0;
+	if (!file_manager.readFileIntoBuffer(path, file, bytes))
+		return 0;
+	cipherBytes = aes.encrypt(file, bytes).size();
+	delete[] file;
+	return crc;
+}
+
+/* Fused path: the file is read once, CRC and encryption from the same buffer. */
+static uint32_t fused(FileManager& file_manager, AESWrapper& aes, const std::string& path, size_t& cipherBytes, const CipherMode mode)
+{
+	FileEncryptor encryptor(file_manager, aes, mode);
+	cipherBytes = 0;
+	if (!encryptor.open(path))
+		return 0;
+	while (!encryptor.finished()) {
+		const uint8_t* cipher = nullptr;
+		size_t size = 0;
+		if (!encryptor.nextChunk(cipher, size))
+			return 0;
+		cipherBytes += size;
+	}
+	return encryptor.crc();
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t megabytes = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 256;
+	const int rounds = (argc > 2) ? std::atoi(argv[2]) : 3;
+	const size_t bytes = megabytes * 1024 * 1024;
+
+	if (!createFile(BENCH_FILE, bytes)) {
+		std::cout << "Error: Failed to create " << BENCH_FILE << std::endl;
+		return 1;
+	}
+
+	SymetricKey key;
+	for (size_t i = 0; i < SYMETRIC_KEY_SIZE; i++)
+		key.symetricKey[i] = static_cast<uint8_t>(i);
+
+	FileManager file_manager;
+	AESWrapper aes(key);
+	double best[3] = { 0, 0, 0 };
+	uint32_t crcs[3] = { 0, 0, 0 };
+
+	for (int round = 0; round < rounds; round++) {
+		for (int path = 0; path < 3; path++) {
+			size_t cipherBytes = 0;
+			const auto start = std::chrono::steady_clock::now();
+			if (path == 0)
+				crcs[path] = twoPass(file_manager, aes, BENCH_FILE, cipherBytes);
+			else
+				crcs[path] = fused(file_manager, aes, BENCH_FILE, cipherBytes, (path == 1) ? CipherMode::CBC : CipherMode::GCM);
+			const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			const double rate = bytes / elapsed.count();
+			if (rate > best[path])
+				best[path] = rate;
+		}
+	}
+	std::remove(BENCH_FILE);
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "File size: " << megabytes << " MB, best of " << rounds << " rounds" << std::endl;
+	std::cout << "Two pass (calculate_crc + readFileIntoBuffer + encrypt): " << best[0] / (1024 * 1024) << " MB/s" << std::endl;
+	std::cout << "Fused (FileEncryptor):                                   " << best[1] / (1024 * 1024) << " MB/s" << std::endl;
+	std::cout << "Fused, GCM records (FileEncryptor):                      " << best[2] / (1024 * 1024) << " MB/s" << std::endl;
+	if (crcs[0] != crcs[1] || crcs[0] != crcs[2]) {
+		std::cout << "Error: CRC values differ: " << crcs[0] << ", " << crcs[1] << " and " << crcs[2] << std::endl;
+		return 1;
+	}
+	return 0;
+}
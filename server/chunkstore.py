@@ -0,0 +1,63 @@
+import os
+import hashlib
+import zlib  # crc calculation
+
+""" Chunk store class. Chunks of uploaded files are kept once, by their SHA-256 hash, in a store of every client, so a
+    chunk that the client already uploaded (in any file) is not sent again. Files are assembled from the chunks. """
+
+
+class ChunkStore:
+    HASH_SIZE = 32  # SHA-256
+    COPY_SIZE = 1024 * 1024  # bytes copied at once while assembling a file
+
+    def __init__(self, root):
+        self.root = root
+
+    """ The function returns the path of the chunk, chunks are spread in sub directories by the first byte of the hash. """
+    def path(self, client_id, chunk_hash):
+        hex_hash = chunk_hash.hex()
+        return os.path.join(self.root, client_id.hex(), hex_hash[:2], hex_hash)
+
+    """ The function checks if the store has the chunk of the client. """
+    def has(self, client_id, chunk_hash):
+        return os.path.isfile(self.path(client_id, chunk_hash))
+
+    """ The function stores the chunk (plain content) under its hash and returns the hash. The chunk is written to a
+        temporary file and renamed, so a chunk in the store is always complete. """
+    def put(self, client_id, content):
+        chunk_hash = hashlib.sha256(content).digest()
+        chunk_path = self.path(client_id, chunk_hash)
+        if not os.path.isfile(chunk_path):
+            os.makedirs(os.path.dirname(chunk_path), exist_ok=True)
+            temp_path = f"{chunk_path}.{os.getpid()}.tmp"
+            with open(temp_path, 'wb') as f:
+                f.write(content)
+            os.replace(temp_path, chunk_path)
+        return chunk_hash
+
+    """ The function writes the file from the chunks, in their order. The content of every chunk is checked against its 
+        hash while it is copied, a damaged chunk is removed from the store so the client sends it again. Returns the size 
+        and the CRC value of the file and the set of the hashes of the damaged chunks. """
+    def assemble(self, client_id, chunk_hashes, file_path):
+        size = 0
+        crc_value = 0
+        damaged = set()
+        with open(file_path, 'wb') as f:
+            for chunk_hash in chunk_hashes:
+                if chunk_hash in damaged:
+                    continue
+                chunk_path = self.path(client_id, chunk_hash)
+                content_hash = hashlib.sha256()
+                with open(chunk_path, 'rb') as chunk:
+                    while True:
+                        content = chunk.read(ChunkStore.COPY_SIZE)
+                        if not content:
+                            break
+                        content_hash.update(content)
+                        crc_value = zlib.crc32(content, crc_value)
+                        size += len(content)
+                        f.write(content)
+                if content_hash.digest() != chunk_hash:
+                    damaged.add(chunk_hash)
+                    os.remove(chunk_path)
+        return size, crc_value, damaged
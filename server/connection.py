@@ -0,0 +1,144 @@
+import request
+import selectors
+
+""" Connection class. Keeps the bytes a client connection received until they make a whole request frame, so the
+    server never waits on one connection: every read event receives what arrived and the request is handled once its
+    whole frame is there. Uploads of many clients are received in parts, interleaved on the one event loop. The content
+    of send file request is not kept: it is received straight into its upload (see upload.FileUpload), which writes it
+    to the file while it arrives. Requests whose CPU heavy stage runs on the workers keep the connection busy, it does
+    not receive until they complete (see Server.process). Responses are queued and sent as the socket takes them, the
+    rest waits for the socket to be writable, so a client that does not read its responses never blocks the server. """
+
+
+class Connection:
+    MAX_JOBS = 8  # jobs of requests without response (chunks) on the workers, the connection waits for them beyond it
+
+    def __init__(self, sock, uploads):
+        self.sock = sock
+        self.uploads = uploads  # starts the upload of send file request from the socket, its header and fields
+        self.buffer = bytearray()  # received bytes of the next requests
+        self.receive_buffer = bytearray(request.RECEIVE_SIZE)
+        self.receive_view = memoryview(self.receive_buffer)
+        self.header = None  # header of the next request, once it arrived
+        self.frame_size = None  # size of the next request frame, once it is known
+        self.head = None  # header and fields of send file request, while its content arrives
+        self.upload = None  # upload of the content of send file request
+        self.pending = False  # a request waits for its job on the workers, the next requests wait for it
+        self.jobs = 0  # jobs of requests without response on the workers
+        self.held = None  # header and frame of the next request, while the jobs before it did not complete
+        self.events = selectors.EVENT_READ  # events the connection is registered for, 0 while it is not
+        self.outgoing = bytearray()  # bytes of the responses the socket did not take yet
+        self.broken = False  # sending failed, nothing more is sent
+        self.closing = False  # the connection is closed once its responses were sent
+
+    """ The function receives the bytes that arrived on the connection, without waiting for more. The content of an
+        upload is received into its record buffer. Returns False if the client closed the connection. """
+    def receive(self):
+        try:
+            if self.head is not None and self.upload.remaining and not self.buffer:
+                size = self.sock.recv_into(self.upload.space())
+                self.upload.received(size)
+            else:
+                size = self.sock.recv_into(self.receive_view)
+                self.buffer += self.receive_view[:size]
+        except (BlockingIOError, InterruptedError):
+            return True  # nothing arrived after all
+        except OSError:
+            return False
+        return size > 0
+
+    """ The function returns the header and the frame of the next request, or None while the whole frame did not arrive
+        yet. The frame is removed from the received bytes. The frame of send file request is its header, fields and
+        trailer, its upload is taken by takeUpload(). Raises ValueError if the request is not valid. """
+    def nextFrame(self):
+        if self.header is None:
+            if len(self.buffer) <= request.CLIENT_ID_SIZE or \
+                    len(self.buffer) < request.headerSize(self.buffer[request.CLIENT_ID_SIZE]):
+                return None  # header arrived in parts, wait for the rest of it
+            header = request.RequestHeader()
+            if not header.unpack(self.buffer):
+                raise ValueError("Failed to parse request header")
+            self.header = header
+
+        if self.frame_size is None:
+            self.frame_size = request.frameSize(self.header, self.buffer)
+            if self.frame_size is None:
+                return None
+        if self.head is None and request.isSendFile(self.header.code):
+            if len(self.buffer) < self.frame_size:
+                return None
+            self.head = self.take(self.frame_size)  # fields arrived, the content follows them
+            self.upload = self.uploads(self.sock, self.header, self.head)
+            self.frame_size = request.trailerSize(self.header.code)
+        if self.head is not None and self.upload.remaining:
+            del self.buffer[:self.upload.feed(self.buffer)]
+            if self.upload.remaining:
+                return None
+        if len(self.buffer) < self.frame_size:
+            return None
+
+        header = self.header
+        frame = self.take(self.frame_size)
+        if self.head is not None:
+            frame = self.head + frame
+        self.header = None
+        self.frame_size = None
+        self.head = None
+        return header, frame
+
+    """ The function removes size bytes from the received bytes and returns them. """
+    def take(self, size):
+        if len(self.buffer) == size:  # the usual case, the bytes are taken without a copy
+            data = self.buffer
+            self.buffer = bytearray()
+            return data
+        data = self.buffer[:size]
+        del self.buffer[:size]
+        return data
+
+    """ The function queues the bytes of a response, they are sent by flush(). Returns False if the connection is
+        broken. """
+    def send(self, data):
+        if self.broken:
+            return False
+        self.outgoing += data
+        return True
+
+    """ The function drops the responses queued after the first size bytes, they were not sent yet. """
+    def drop(self, size):
+        del self.outgoing[size:]
+
+    """ The function sends the queued bytes the socket takes without waiting, the rest is sent when it is writable.
+        Returns False if the connection is broken. """
+    def flush(self):
+        if self.broken:
+            return False
+        try:
+            while self.outgoing:
+                sent = self.sock.send(self.outgoing)
+                del self.outgoing[:sent]
+        except (BlockingIOError, InterruptedError):
+            pass  # the socket is full, the rest waits for it
+        except OSError:
+            self.broken = True
+            self.outgoing.clear()
+            return False
+        return True
+
+    """ The function checks if the connection has enough work on the workers or responses the client did not read, it
+        does not receive until they complete. """
+    def busy(self):
+        return self.pending or self.held is not None or self.jobs >= Connection.MAX_JOBS or \
+            (self.head is not None and self.upload.busy()) or bool(self.outgoing)
+
+    """ The function returns the upload of the last send file request, the connection does not keep it. """
+    def takeUpload(self):
+        upload = self.upload
+        self.upload = None
+        return upload
+
+    """ The function drops the upload that did not complete, the connection is closed. """
+    def close(self):
+        if self.upload is not None:
+            self.upload.abort()
+            self.upload = None
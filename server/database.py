@@ -1,6 +1,9 @@
 import sqlite3
 import request
 import logging
+import contextlib
+import collections
+import time
 
 """ Client class """
 
@@ -60,33 +63,84 @@ class File:
 class Database:
     CLIENTS = "clients"
     FILES = "files"
+    CACHED_STATEMENTS = 64  # prepared statements kept by the connection, every query of the class is one of them
+    MAX_CACHED_CLIENTS = 1024  # client records kept in the memory, the least recently used are dropped
+    LAST_SEEN_BATCH = 256  # last seen updates written at once
+    LAST_SEEN_INTERVAL = 5  # seconds a last seen update may wait to be written
 
     def __init__(self, db_name):
         self.name = db_name
-
-    """ The function connects to the database. """
+        self.conn = None  # connection of the server, opened once and kept
+        self.transactions = 0  # depth of the open transactions, writes are committed when the outer one ends
+        self.clients = collections.OrderedDict()  # cached client records by ID, least recently used first
+        self.names = {}  # IDs of the cached clients by their names
+        self.data_version = None  # version of the database when the cache was checked, see revalidate()
+        self.last_seen = {}  # last seen updates that were not written yet, by client ID
+        self.last_seen_flush = time.monotonic()
+
+    """ The function connects to the database, once. The journal is written ahead (WAL), so a commit appends to the 
+        log without an fsync and readers do not wait for the writer. """
     def connect(self):
-        conn = sqlite3.connect(self.name)
-        conn.text_factory = bytes
-        return conn
-
-    """ The function executes the query with given args and returns the result"""
+        if self.conn is None:
+            self.conn = sqlite3.connect(self.name, cached_statements=Database.CACHED_STATEMENTS)
+            self.conn.text_factory = bytes
+            self.conn.execute("PRAGMA journal_mode=WAL")
+            self.conn.execute("PRAGMA synchronous=NORMAL")  # durable at the checkpoints, enough for WAL
+        return self.conn
+
+    """ The function closes the connection to the database, the last seen updates that wait are written first. The data 
+        version is of the connection, the cache is checked again by the next connection. """
+    def close(self):
+        if self.conn is not None:
+            self.flushLastSeen(True)
+            self.conn.close()
+            self.conn = None
+            self.data_version = None
+
+    """ The function executes the query with given args and returns the result. Within a transaction the writes are 
+        committed when it ends. """
     def execute(self, query, args, commit=False):
         results = None
         conn = self.connect()
         try:
-            cur = conn.cursor()
-            cur.execute(query, args)
+            cur = conn.execute(query, args)
             if commit:
-                conn.commit()
+                if not self.transactions:
+                    conn.commit()
                 results = True
             else:
                 results = cur.fetchall()
         except Exception as e:
             logging.exception(f'Database execute: {e}')
-        conn.close()
         return results
 
+    """ The function opens a transaction for the queries of a request: all its writes are committed at once when it 
+        ends, one commit instead of a commit for every write. """
+    @contextlib.contextmanager
+    def transaction(self):
+        if not self.transactions:
+            self.revalidate()
+        self.transactions += 1
+        try:
+            yield
+        finally:
+            self.transactions -= 1
+            if not self.transactions:
+                try:
+                    self.connect().commit()
+                except Exception as e:
+                    logging.exception(f'Database commit: {e}')
+
+    """ The function rolls back the writes of the open transaction so far, the writes after it are committed when the
+        transaction ends. The cached clients are dropped, they may hold the writes that were rolled back. """
+    def rollback(self):
+        try:
+            self.connect().rollback()
+        except Exception as e:
+            logging.exception(f'Database rollback: {e}')
+        self.clients.clear()
+        self.names.clear()
+
     """The function executes script, used for initializing the database. """
     def executescript(self, script):
         conn = self.connect()
@@ -95,7 +149,6 @@ class Database:
             conn.commit()
         except:
             pass  # maybe the table already exists
-        conn.close()
 
     """Database initialization function. """
     def initialize(self):
@@ -122,19 +175,63 @@ class Database:
             );
             """)
 
+        # Clients are looked up by their name on registration and key exchange, a name is registered once even by 
+        # listeners that register it at the same time. Files are looked up by the client ID and the file name, the 
+        # index of the primary key. The index of the names that were not unique is dropped once it is replaced.
+        self.executescript(f"""
+            CREATE UNIQUE INDEX IF NOT EXISTS ClientsUniqueName ON {Database.CLIENTS}(Name);
+            DROP INDEX IF EXISTS ClientsName;
+            """)
+
+    """ The function drops the cached clients if another connection changed the database since the last check (the data 
+        version of SQLite changes with the commits of the other connections only), so the cache is never stale. """
+    def revalidate(self):
+        results = self.execute("PRAGMA data_version", [])
+        data_version = results[0][0] if results else None
+        if data_version != self.data_version:
+            self.clients.clear()
+            self.names.clear()
+            self.data_version = data_version
+
+    """ The function returns the record of the client by given client ID, or None if there is no such client. Records 
+        are cached, the least recently used ones are dropped. """
+    def getClient(self, client_id):
+        client = self.clients.get(client_id)
+        if client is not None:
+            self.clients.move_to_end(client_id)
+            return client
+        results = self.execute(f"SELECT ID, Name, PublicKey, SymmetricKey, LastSeen FROM {Database.CLIENTS} WHERE ID = ?",
+                               [client_id])
+        if not results:
+            return None
+        cid, name, public_key, symmetric_key, last_seen = results[0]
+        client = Client(cid.hex(), name, last_seen)
+        client.PublicKey = public_key
+        client.SymmetricKey = symmetric_key
+        self.clients[client_id] = client
+        self.names[name] = client_id
+        if len(self.clients) > Database.MAX_CACHED_CLIENTS:
+            _, dropped = self.clients.popitem(last=False)
+            self.names.pop(dropped.Name, None)
+        return client
+
+    """ The function returns the cached record of the client by given username, None if it is not cached. """
+    def cachedClientByName(self, username):
+        client_id = self.names.get(username.encode('utf-8') if isinstance(username, str) else username)
+        return None if client_id is None else self.clients.get(client_id)
+
     """" The function checks if username already exists in the database. """
     def clientUsernameExists(self, username):
-        results = self.execute(f"SELECT * FROM {Database.CLIENTS} WHERE Name = ?", [username])
+        if self.cachedClientByName(username) is not None:
+            return True
+        results = self.execute(f"SELECT ID FROM {Database.CLIENTS} WHERE Name = ?", [username])
         if not results:
             return False
         return len(results) > 0
 
     """ The function checks if given client ID already exists in the database. """
     def clientIdExists(self, client_id):
-        results = self.execute(f"SELECT * FROM {Database.CLIENTS} WHERE ID = ?", [client_id])
-        if not results:
-            return False
-        return len(results) > 0
+        return self.getClient(client_id) is not None
 
     """ The function checks if given client has specific file, by given client ID and file name. """
     def fileExists(self, client_id, file_name):
@@ -159,41 +256,94 @@ class Database:
         return self.execute(f"UPDATE {Database.FILES} SET Verified = ? WHERE ID = ? AND FileName = ?",
                             [verified, client_id, file_name], True)
 
-    """ The function stores the client into the database. """
+    """ The function stores the client into the database. Raises sqlite3.IntegrityError if its name is registered 
+        already. """
     def storeClient(self, client):
         if not type(client) is Client or not client.validate():
             return False
-        return self.execute(f"INSERT INTO {Database.CLIENTS} VALUES (?, ?, ?, ?, ?)",
-                            [client.ID, client.Name, client.SymmetricKey, client.PublicKey, client.LastSeen], True)
+        conn = self.connect()
+        try:
+            conn.execute(f"INSERT INTO {Database.CLIENTS} VALUES (?, ?, ?, ?, ?)",
+                         [client.ID, client.Name, client.SymmetricKey, client.PublicKey, client.LastSeen])
+        except sqlite3.IntegrityError:
+            raise  # the name was registered meanwhile, by another listener
+        except Exception as e:
+            logging.exception(f'Database execute: {e}')
+            return False
+        if not self.transactions:
+            conn.commit()
+        return True
 
     """ The function returns client public key by given client ID. """
     def getClientPublicKey(self, client_id):
-        results = self.execute(f"SELECT PublicKey FROM {Database.CLIENTS} WHERE ID = ?", [client_id])
-        if not results:
+        client = self.getClient(client_id)
+        if client is None:
             return None
-        return results[0][0]
+        return client.PublicKey
 
     """ The function returns client symmetric key by given clients ID. """
     def getClientSymKey(self, client_id):
-        results = self.execute(f"SELECT SymmetricKey FROM {Database.CLIENTS} WHERE ID = ?", [client_id])
-        if not results:
+        client = self.getClient(client_id)
+        if client is None:
             return None
-        return results[0][0]
+        return client.SymmetricKey
 
     """ The function sets up client public key into the database, by given client ID and public key."""
     def setPublicKey(self, username, public_key):
-        return self.execute(f"UPDATE {Database.CLIENTS} SET PublicKey = ? WHERE Name = ?",
-                            [public_key, username], True)
+        result = self.execute(f"UPDATE {Database.CLIENTS} SET PublicKey = ? WHERE Name = ?",
+                              [public_key, username], True)
+        client = self.cachedClientByName(username)
+        if result and client is not None:
+            client.PublicKey = public_key
+        return result
 
     """ The function sets up client symmetric key by given username and symmetric key. """
     def setSymmetricKey(self, username, symmetric_key):
-        return self.execute(f"UPDATE {Database.CLIENTS} SET SymmetricKey = ? WHERE NAME = ?",
-                            [symmetric_key, username], True)
-
-    """ The function sets last seen of a specific client. """
+        result = self.execute(f"UPDATE {Database.CLIENTS} SET SymmetricKey = ? WHERE NAME = ?",
+                              [symmetric_key, username], True)
+        client = self.cachedClientByName(username)
+        if result and client is not None:
+            client.SymmetricKey = symmetric_key
+        return result
+
+    """ The function sets up client symmetric key by given client ID and symmetric key. """
+    def setClientSymKey(self, client_id, symmetric_key):
+        result = self.execute(f"UPDATE {Database.CLIENTS} SET SymmetricKey = ? WHERE ID = ?",
+                              [symmetric_key, client_id], True)
+        client = self.clients.get(client_id)
+        if result and client is not None:
+            client.SymmetricKey = symmetric_key
+        return result
+
+    """ The function sets last seen of a specific client. The update is written behind: updates of the same client are 
+        merged and written together with the updates of other clients (see flushLastSeen). """
     def setLastSeen(self, client_id, last_seen):
-        return self.execute(f"UPDATE {Database.CLIENTS} SET LastSeen = ? WHERE ID = ?",
-                            [last_seen, client_id], True)
+        self.last_seen[client_id] = last_seen
+        client = self.clients.get(client_id)
+        if client is not None:
+            client.LastSeen = last_seen
+        if len(self.last_seen) >= Database.LAST_SEEN_BATCH:
+            self.flushLastSeen(True)
+        return True
+
+    """ The function writes the last seen updates that wait, once LAST_SEEN_INTERVAL passed since the last time they 
+        were written, or now if force. """
+    def flushLastSeen(self, force=False):
+        now = time.monotonic()
+        if not self.last_seen or (not force and now - self.last_seen_flush < Database.LAST_SEEN_INTERVAL):
+            return True
+        updates = [(last_seen, client_id) for client_id, last_seen in self.last_seen.items()]
+        self.last_seen.clear()
+        self.last_seen_flush = now
+        conn = self.connect()
+        try:
+            conn.executemany(f"UPDATE {Database.CLIENTS} SET LastSeen = ? WHERE ID = ?", updates)
+            if not self.transactions:
+                conn.commit()
+        except Exception as e:
+            logging.exception(f'Database last seen: {e}')
+            return False
+        return True
 
     """ The function return client ID by given username. """
     def getClientIDbyUsername(self, username):
@@ -204,8 +354,8 @@ class Database:
 
     """" The function return client username by given ID."""
     def getClientUsernameByID(self, client_id):
-        results = self.execute(f"SELECT Name From {Database.CLIENTS} WHERE ID = ?", [client_id])
-        if not results:
+        client = self.getClient(client_id)
+        if client is None:
             return None
-        return results[0][0]
+        return client.Name
 
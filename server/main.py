@@ -9,6 +9,11 @@ if __name__ == '__main__':
     if port is None:
         logging.error("port.info file is not found, initializing by default settings.")
         port = DEFAULT_PORT
-    svr = server.Server('', port)  # don't care about host.
+    listeners, backlog = server.parseListeners(PORT_INFO)  # optional second line: "<listeners> [<backlog>]"
+    if listeners is None or listeners < 1:
+        listeners = server.Server.LISTENERS
+    if backlog is None or backlog < 1:
+        backlog = server.Server.MAX_QUEUED_CONN
+    svr = server.Server('', port, listeners, backlog)  # don't care about host.
     if not svr.start():
         server.stopServer(f"Server start exception: {svr.lastErr}")
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 from enum import Enum
 import struct
+import zlib
 
 
 # Request Operation Codes
@@ -13,6 +14,16 @@ class ClientRequestCode(Enum):
     REQUEST_VALID_CRC = 1104
     REQUEST_INVALID_CRC = 1105
     REQUEST_FINAL_INVALID_CRC = 1106
+    REQUEST_QUERY_CHUNKS = 1107
+    REQUEST_SEND_CHUNK = 1108
+    REQUEST_SEND_CHUNKED_FILE = 1109
+    REQUEST_SEND_FILE_GCM = 1110
+    REQUEST_SEND_CHUNK_GCM = 1111
+    REQUEST_COMMIT_FILE_GCM = 1112
+    REQUEST_COMMIT_CHUNKED_FILE = 1113
+    REQUEST_COMMIT_COMPRESSED_FILE_GCM = 1114
+    REQUEST_SEND_COMPRESSED_CHUNK_GCM = 1115
+    REQUEST_RESUME_SESSION = 1116
 
 
 # Response Operation Codes
@@ -25,11 +36,24 @@ class ServerResponseCode(Enum):
     RESPONSE_RECONNECTION_ACCEPTED = 2105
     RESPONSE_RECONNECTION_DENIED = 2106
     RESPONSE_SERVER_ERROR = 2107
+    RESPONSE_CHUNKS_MISSING = 2108
+    RESPONSE_FILE_COMMITTED = 2109
+    RESPONSE_SESSION_RESUMED = 2110
+
+
+# Compression of the content before its encryption, chosen by the client for every file and chunk
+class Compression(Enum):
+    NONE = 0
+    ZLIB = 1
 
 
 # Constants and Defined variables
 INIT_VALUE = 0  # default initializing value
-SERVER_VERSION = 3  # server version
+SERVER_VERSION = 6  # server version, protocol v6: v5 with session tickets
+TICKET_VERSION = 6  # protocol v6: session ticket after the encrypted key of key exchange and reconnection responses
+LARGE_VERSION = 5  # protocol v5: v4 with 64-bit sizes of the payloads, the files and the contents
+COMPACT_VERSION = 4  # protocol v4: exact length frames and length prefixed names
+LEGACY_VERSION = 3  # protocol v3: fixed size names and packets padded to PACKET_SIZE
 
 VERSION_SIZE = 1  # 1 byte
 OPERATION_CODE_SIZE = 2  # 2 bytes
@@ -38,6 +62,176 @@ PUBLIC_KEY_SIZE = 160
 SYMETRIC_KEY_SIZE = 16
 CLIENT_ID_SIZE = 16
 PAYLOAD_SIZE = 4  # 4 bytes
+LARGE_SIZE = 8  # v5 payload size of a request and sizes of the files and the contents, 8 bytes
+CRC_SIZE = 4  # CRC value of the client after the content of a commit request
+COMPRESSION_SIZE = 1  # compression of the content, 1 byte
+NAME_LENGTH_SIZE = 1  # v4 names are prefixed by their length
+PACKET_SIZE = 1024  # v3 requests are padded to packets of this size
+MAX_CONTROL_PAYLOAD_SIZE = 1024  # every request except send file fits in it
+CHUNK_HASH_SIZE = 32  # SHA-256 of the chunk content
+MAX_QUERY_CHUNKS = 1024  # chunk hashes in one query chunks request
+MAX_CHUNK_SIZE = 256 * 1024  # content defined chunks of the client are not bigger
+MAX_FILE_CHUNKS = 2 * 1024 * 1024  # chunks of a chunked file, 128 GB in chunks of 64 KB on average
+MAX_CHUNKED_FILE_PAYLOAD_SIZE = LARGE_SIZE + NAME_LENGTH_SIZE + NAME_SIZE + PAYLOAD_SIZE + MAX_FILE_CHUNKS * CHUNK_HASH_SIZE
+RECEIVE_SIZE = 64 * 1024  # bytes received from a connection on one read event
+GCM_NONCE_SIZE = 12  # AES-GCM nonce of a record or a chunk
+GCM_NONCE_PREFIX_SIZE = 8  # random part of the nonces of a file, the record index follows it
+GCM_TAG_SIZE = 16  # authentication tag after every record
+GCM_RECORD_SIZE = 64 * 1024  # plain bytes of a file record, every record is sealed on its own
+GCM_LAST_RECORD = 0x80000000  # set in the record index of the last record, a cut file is not taken as whole
+TICKET_SIZE = 68  # session ticket, sealed by the server (ticket.SessionTickets)
+RESUME_NONCE_SIZE = 16  # nonces of the client and the server the resumed symmetric key is derived from
+
+
+""" The function checks if the version uses v4 compact framing (exact length frames, length prefixed names). """
+def isCompact(version):
+    return version >= COMPACT_VERSION
+
+
+""" The function returns the version of the response for a request version, the server answers in the version of the
+    request, v3 and older clients get v3 responses. """
+def responseVersion(version):
+    return min(version, SERVER_VERSION) if isCompact(version) else LEGACY_VERSION
+
+
+""" The function returns the size of the payload size field and of the size fields of the files and the contents in the 
+    version: 8 bytes from v5, 4 bytes before. """
+def sizeFieldSize(version):
+    return LARGE_SIZE if version >= LARGE_VERSION else PAYLOAD_SIZE
+
+
+""" The function checks if the responses of the version carry session tickets. """
+def hasTickets(version):
+    return version >= TICKET_VERSION
+
+
+""" The function returns the size of the request header in the version. """
+def headerSize(version):
+    return CLIENT_ID_SIZE + VERSION_SIZE + OPERATION_CODE_SIZE + sizeFieldSize(version)
+
+
+""" The function unpacks a size field (of a file or a content) at the offset in the version's format, returns the size 
+    and the offset after it. """
+def unpackSize(data, offset, version):
+    field_size = sizeFieldSize(version)
+    value = struct.unpack("<Q" if field_size == LARGE_SIZE else "<I", data[offset:offset + field_size])[0]
+    return value, offset + field_size
+
+
+""" The function packs a size field in the version's format. """
+def packSize(value, version):
+    return struct.pack("<Q" if sizeFieldSize(version) == LARGE_SIZE else "<I", value)
+
+
+""" The function unpacks a name at the offset in the version's format, returns the name and the offset after it. """
+def unpackName(data, offset, version):
+    if isCompact(version):
+        length = data[offset]
+        name = data[offset + NAME_LENGTH_SIZE:offset + NAME_LENGTH_SIZE + length]
+        if len(name) != length:
+            raise ValueError("Name is longer than the data")
+        return name.decode('utf-8'), offset + NAME_LENGTH_SIZE + length
+    name = struct.unpack(f"<{NAME_SIZE}s", data[offset:offset + NAME_SIZE])[0]
+    return str(name.partition(b'\0')[0].decode('utf-8')), offset + NAME_SIZE
+
+
+""" The function packs a name (bytes) in the version's format. """
+def packName(name, version):
+    if isCompact(version):
+        return struct.pack(f"<B{len(name)}s", len(name), name)
+    return struct.pack(f"<{NAME_SIZE}s", name)
+
+
+""" The function checks if the request sends a whole file, its content is streamed to the file while it arrives. """
+def isSendFile(code):
+    return code in (ClientRequestCode.REQUEST_SEND_FILE.value, ClientRequestCode.REQUEST_SEND_FILE_GCM.value,
+                    ClientRequestCode.REQUEST_COMMIT_FILE_GCM.value,
+                    ClientRequestCode.REQUEST_COMMIT_COMPRESSED_FILE_GCM.value)
+
+
+""" The function checks if the request sends a chunk, chunks are not answered. """
+def isChunk(code):
+    return code in (ClientRequestCode.REQUEST_SEND_CHUNK.value, ClientRequestCode.REQUEST_SEND_CHUNK_GCM.value,
+                    ClientRequestCode.REQUEST_SEND_COMPRESSED_CHUNK_GCM.value)
+
+
+""" The function checks if the request commits the file: the CRC value of the client follows the file, the server 
+    verifies the file by it and does not wait for valid CRC request. """
+def isCommit(code):
+    return code in (ClientRequestCode.REQUEST_COMMIT_FILE_GCM.value, ClientRequestCode.REQUEST_COMMIT_CHUNKED_FILE.value,
+                    ClientRequestCode.REQUEST_COMMIT_COMPRESSED_FILE_GCM.value)
+
+
+""" The function checks if the content of the request may be compressed, the compression follows the fixed fields. """
+def isCompressed(code):
+    return code in (ClientRequestCode.REQUEST_COMMIT_COMPRESSED_FILE_GCM.value,
+                    ClientRequestCode.REQUEST_SEND_COMPRESSED_CHUNK_GCM.value)
+
+
+""" The function decompresses the decrypted content by the compression the client chose. The content may not be bigger 
+    than max_size, a small content can not be inflated to fill the memory of the server. Raises ValueError if the 
+    compression is not known or the content is not valid. """
+def decompress(content, compression, max_size):
+    if compression == Compression.NONE.value:
+        return content
+    if compression != Compression.ZLIB.value:
+        raise ValueError(f"Compression {compression} is not supported")
+    try:
+        decompressor = zlib.decompressobj()
+        plain = decompressor.decompress(content, max_size)
+    except zlib.error as e:
+        raise ValueError(f"Compressed content is not valid: {e}")
+    if not decompressor.eof or decompressor.unconsumed_tail or decompressor.unused_data:
+        raise ValueError("Compressed content is bigger than expected or cut off")
+    return plain
+
+
+""" The function returns the size of the request frame (header and the bytes of the request after it), or None while 
+    the bytes that arrived are not enough to know it. v4 frames are the header and payload_size bytes, v3 requests are 
+    padded packets. The frame of send file request is its header and fields only, the content that follows them is 
+    received by its upload (see upload.FileUpload) and the trailer after it (see trailerSize). Raises ValueError if the 
+    payload is too big for the request. """
+def frameSize(header, data):
+    if isSendFile(header.code):
+        offset = header.size + sizeFieldSize(header.version)  # content size
+        if isCompact(header.version):
+            if len(data) <= offset:
+                return None
+            offset += NAME_LENGTH_SIZE + data[offset]
+        else:
+            offset += NAME_SIZE
+        if isCompressed(header.code):
+            offset += COMPRESSION_SIZE + sizeFieldSize(header.version)
+        return offset
+    if isCompact(header.version):
+        if header.payload_size > maxPayloadSize(header.code):
+            raise ValueError(f"Payload size {header.payload_size} is too big")
+        return header.size + header.payload_size
+    return PACKET_SIZE
+
+
+""" The function returns the size of the fields that follow the content of send file request. """
+def trailerSize(code):
+    return CRC_SIZE if isCommit(code) else 0
+
+
+""" The function returns the biggest legal payload size of a v4 request, by its code. Send file content is streamed to
+    the file and is not limited here. """
+def maxPayloadSize(code):
+    if code == ClientRequestCode.REQUEST_QUERY_CHUNKS.value:
+        return PAYLOAD_SIZE + MAX_QUERY_CHUNKS * CHUNK_HASH_SIZE
+    if code == ClientRequestCode.REQUEST_SEND_CHUNK.value:
+        return LARGE_SIZE + MAX_CHUNK_SIZE + 16  # padding block of the encrypted chunk
+    if code == ClientRequestCode.REQUEST_SEND_CHUNK_GCM.value:
+        return LARGE_SIZE + GCM_NONCE_SIZE + MAX_CHUNK_SIZE + GCM_TAG_SIZE
+    if code == ClientRequestCode.REQUEST_SEND_COMPRESSED_CHUNK_GCM.value:  # compressed chunk is smaller than the chunk
+        return LARGE_SIZE + COMPRESSION_SIZE + GCM_NONCE_SIZE + MAX_CHUNK_SIZE + GCM_TAG_SIZE
+    if code == ClientRequestCode.REQUEST_SEND_CHUNKED_FILE.value:
+        return MAX_CHUNKED_FILE_PAYLOAD_SIZE
+    if code == ClientRequestCode.REQUEST_COMMIT_CHUNKED_FILE.value:
+        return MAX_CHUNKED_FILE_PAYLOAD_SIZE + CRC_SIZE
+    return MAX_CONTROL_PAYLOAD_SIZE
+
 
 """ Class of arriving request header, every legal request has an header."""
 
@@ -47,16 +241,18 @@ class RequestHeader:
         self.clientID = b""  # bytes type instance
         self.version = INIT_VALUE  # 1 byte
         self.code = INIT_VALUE  # 2 bytes
-        self.payload_size = INIT_VALUE  # 4 bytes
-        self.size = CLIENT_ID_SIZE + VERSION_SIZE + OPERATION_CODE_SIZE + PAYLOAD_SIZE
+        self.payload_size = INIT_VALUE  # 4 bytes, 8 bytes from v5
+        self.size = headerSize(LEGACY_VERSION)  # smallest header until the version is known
 
     """ Request header little endian unpack function. """
 
     def unpack(self, data):
         try:
             self.clientID = struct.unpack(f"<{CLIENT_ID_SIZE}s", data[:CLIENT_ID_SIZE])[0]
-            header_data = data[CLIENT_ID_SIZE:CLIENT_ID_SIZE + VERSION_SIZE + OPERATION_CODE_SIZE + PAYLOAD_SIZE]
-            self.version, self.code, self.payload_size = struct.unpack("<BHL", header_data)
+            offset = CLIENT_ID_SIZE + VERSION_SIZE + OPERATION_CODE_SIZE
+            self.version, self.code = struct.unpack("<BH", data[CLIENT_ID_SIZE:offset])
+            self.payload_size = unpackSize(data, offset, self.version)[0]
+            self.size = headerSize(self.version)
             return True
         except:
             self.__init__()  # reset values
@@ -67,8 +263,8 @@ class RequestHeader:
 
 
 class ResponseHeader:
-    def __init__(self, code):
-        self.version = SERVER_VERSION  # 1 byte
+    def __init__(self, code, version=SERVER_VERSION):
+        self.version = responseVersion(version)  # 1 byte
         self.code = code  # 2 bytes
         self.payload_size = INIT_VALUE  # 4 bytes
         self.size = INIT_VALUE
@@ -94,8 +290,7 @@ class RegistrationRequest:
         if not self.header.unpack(data):
             return False
         try:
-            requested_name = data[self.header.size:self.header.size + NAME_SIZE]
-            self.name = str(struct.unpack(f"<{NAME_SIZE}s", requested_name)[0].partition(b'\0')[0].decode('utf-8'))
+            self.name = unpackName(data, self.header.size, self.header.version)[0]
             return True
         except:
             self.name = b""
@@ -106,8 +301,8 @@ class RegistrationRequest:
 
 
 class RegistrationSuccessResponse:
-    def __init__(self):
-        self.header = ResponseHeader(ServerResponseCode.RESPONSE_REGISTRATION_SUCCESS.value)
+    def __init__(self, version=SERVER_VERSION):
+        self.header = ResponseHeader(ServerResponseCode.RESPONSE_REGISTRATION_SUCCESS.value, version)
         self.clientID = b""
 
     """ Response header and client ID little endian pack function. """
@@ -124,8 +319,8 @@ class RegistrationSuccessResponse:
 
 
 class RegistrationFailureResponse:
-    def __init__(self):
-        self.header = ResponseHeader(ServerResponseCode.RESPONSE_REGISTRATION_FAILURE.value)
+    def __init__(self, version=SERVER_VERSION):
+        self.header = ResponseHeader(ServerResponseCode.RESPONSE_REGISTRATION_FAILURE.value, version)
 
     """ Response header and client ID little endian pack function. """
     def pack(self):
@@ -150,9 +345,8 @@ class KeyExchangeRequest:
         if not self.header.unpack(data):
             return False
         try:
-            client_name = data[self.header.size:self.header.size + NAME_SIZE]
-            self.name = str(struct.unpack(f"<{NAME_SIZE}s", client_name)[0].partition(b'\0')[0].decode('utf-8'))
-            key = data[self.header.size + NAME_SIZE:self.header.size + NAME_SIZE + PUBLIC_KEY_SIZE]
+            self.name, offset = unpackName(data, self.header.size, self.header.version)
+            key = data[offset:offset + PUBLIC_KEY_SIZE]
             self.public_key = struct.unpack(f"<{PUBLIC_KEY_SIZE}s", key)[0]
             return True
         except:
@@ -165,10 +359,11 @@ class KeyExchangeRequest:
 
 
 class KeyExchangeResponse:
-    def __init__(self, ):
-        self.header = ResponseHeader(ServerResponseCode.RESPONSE_KEY_EXCHANGE.value)
+    def __init__(self, version=SERVER_VERSION):
+        self.header = ResponseHeader(ServerResponseCode.RESPONSE_KEY_EXCHANGE.value, version)
         self.clientID = b""
         self.encrypted_key = b""
+        self.ticket = b""  # v6: session ticket of the new symmetric key
 
     """ Response header key exchange response information little endian pack function. """
     def pack(self):
@@ -176,6 +371,7 @@ class KeyExchangeResponse:
             data = self.header.pack()
             data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
             data += struct.pack(f"<{len(self.encrypted_key)}s", self.encrypted_key)
+            data += self.ticket
             return data
         except:
             return b""
@@ -194,8 +390,7 @@ class ReconnectionRequest:
         if not self.header.unpack(data):
             return False
         try:
-            requested_name = data[self.header.size:self.header.size + NAME_SIZE]
-            self.name = str(struct.unpack(f"<{NAME_SIZE}s", requested_name)[0].partition(b'\0')[0].decode('utf-8'))
+            self.name = unpackName(data, self.header.size, self.header.version)[0]
             return True
         except:
             self.name = b""
@@ -206,10 +401,11 @@ class ReconnectionRequest:
 
 
 class ReconnectionAcceptResponse:
-    def __init__(self, ):
-        self.header = ResponseHeader(ServerResponseCode.RESPONSE_RECONNECTION_ACCEPTED.value)
+    def __init__(self, version=SERVER_VERSION):
+        self.header = ResponseHeader(ServerResponseCode.RESPONSE_RECONNECTION_ACCEPTED.value, version)
         self.clientID = b""
         self.encrypted_key = b""
+        self.ticket = b""  # v6: session ticket of the new symmetric key
 
     """ Response header and reconnection information little endian pack function. """
     def pack(self):
@@ -217,6 +413,53 @@ class ReconnectionAcceptResponse:
             data = self.header.pack()
             data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
             data += struct.pack(f"<{len(self.encrypted_key)}s", self.encrypted_key)
+            data += self.ticket
+            return data
+        except:
+            return b""
+
+
+""" Resume session request, the nonce of the client and the session ticket of its last symmetric key. """
+
+
+class ResumeSessionRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.nonce = b""
+        self.ticket = b""
+
+    """ Request header, nonce and ticket little endian unpack function. """
+    def unpack(self, data):
+        if not self.header.unpack(data):
+            return False
+        try:
+            offset = self.header.size
+            self.nonce, self.ticket = struct.unpack(f"<{RESUME_NONCE_SIZE}s{TICKET_SIZE}s",
+                                                    data[offset:offset + RESUME_NONCE_SIZE + TICKET_SIZE])
+            return True
+        except:
+            self.nonce = b""
+            self.ticket = b""
+            return False
+
+
+""" Session resumed response, the nonce of the server and the session ticket of the new symmetric key. """
+
+
+class SessionResumedResponse:
+    def __init__(self, version=SERVER_VERSION):
+        self.header = ResponseHeader(ServerResponseCode.RESPONSE_SESSION_RESUMED.value, version)
+        self.clientID = b""
+        self.nonce = b""
+        self.ticket = b""
+
+    """ Response header, client ID, nonce and ticket little endian pack function. """
+    def pack(self):
+        try:
+            self.header.payload_size = CLIENT_ID_SIZE + RESUME_NONCE_SIZE + TICKET_SIZE
+            data = self.header.pack()
+            data += struct.pack(f"<{CLIENT_ID_SIZE}s{RESUME_NONCE_SIZE}s{TICKET_SIZE}s", self.clientID, self.nonce,
+                                self.ticket)
             return data
         except:
             return b""
@@ -226,8 +469,8 @@ class ReconnectionAcceptResponse:
 
 
 class ReconnectionDeniedResponse:
-    def __init__(self, ):
-        self.header = ResponseHeader(ServerResponseCode.RESPONSE_RECONNECTION_DENIED.value)
+    def __init__(self, version=SERVER_VERSION):
+        self.header = ResponseHeader(ServerResponseCode.RESPONSE_RECONNECTION_DENIED.value, version)
         self.clientID = b""
 
     """ Response header and client ID little endian pack function. """
@@ -248,45 +491,35 @@ class FileSendRequest:
         self.header = RequestHeader()
         self.contentSize = INIT_VALUE
         self.fileName = b""
-        self.content = b""
-
-    """ Request header, file and file information little endian unpack function. """
-    def unpack(self, conn, data):
-        packet_size = len(data)
+        self.cksum = None  # CRC value of the client, commit requests only
+        self.compression = Compression.NONE.value
+        self.fileSize = INIT_VALUE  # size of the file before its compression, compressed requests only
+        self.trailerOffset = INIT_VALUE  # offset of the trailer in the frame, the content is not a part of it
+
+    """ Request header, file and file information little endian unpack function. The frame is the header, the fields 
+        and the trailer, the content between them is streamed to the upload of the request (see frameSize). The CRC 
+        value of the trailer is unpacked if it arrived already. """
+    def unpack(self, data):
         if not self.header.unpack(data):
             return False
 
         try:
-            content_size = data[self.header.size: self.header.size + PAYLOAD_SIZE]
-            self.contentSize = struct.unpack("<I", content_size)[0]
-            file_name = data[self.header.size + PAYLOAD_SIZE: self.header.size + PAYLOAD_SIZE + NAME_SIZE]
-            self.fileName = str(struct.unpack(f"<{NAME_SIZE}s", file_name)[0].partition(b'\0')[0].decode('utf-8'))
-
-            offset = self.header.size + PAYLOAD_SIZE + NAME_SIZE        # how many bytes read till this moment
-            read_bytes_from_content = packet_size - offset
-
-            # read more than the file itself (till the end of the packet)
-            if read_bytes_from_content > self.contentSize:
-                read_bytes_from_content = self.contentSize
-
-            self.content = struct.unpack(f"<{read_bytes_from_content}s",
-                                         data[offset:offset + read_bytes_from_content])[0]
-
-            # While read less than the content have, keep reading (every time, packet size)
-            while read_bytes_from_content < self.contentSize:
-                data = conn.recv(packet_size)  # reuse first size of data.
-                dataSize = len(data)
-                if (self.contentSize - read_bytes_from_content) < dataSize:
-                    dataSize = self.contentSize - read_bytes_from_content
-                self.content += struct.unpack(f"<{dataSize}s", data[:dataSize])[0]
-                read_bytes_from_content += dataSize
-                conn.settimeout(5)      # Without timeout it is possible that will be packet loss or errors appier
+            self.contentSize, offset = unpackSize(data, self.header.size, self.header.version)
+            self.fileName, offset = unpackName(data, offset, self.header.version)
+            if isCompressed(self.header.code):
+                self.compression = data[offset]
+                self.fileSize, offset = unpackSize(data, offset + COMPRESSION_SIZE, self.header.version)
+            self.trailerOffset = offset
+            if isCommit(self.header.code) and len(data) >= offset + CRC_SIZE:
+                self.cksum = struct.unpack("<I", data[offset:offset + CRC_SIZE])[0]
             return True
 
         except:
             self.contentSize = INIT_VALUE
             self.fileName = b""
-            self.content = b""
+            self.cksum = None
+            self.trailerOffset = INIT_VALUE
+            self.compression = Compression.NONE.value
             return False
 
 
@@ -294,8 +527,8 @@ class FileSendRequest:
 
 
 class SendFileResponse:
-    def __init__(self):
-        self.header = ResponseHeader(ServerResponseCode.RESPONSE_FILE_DELIVERED_WITH_CRC.value)
+    def __init__(self, version=SERVER_VERSION, code=ServerResponseCode.RESPONSE_FILE_DELIVERED_WITH_CRC.value):
+        self.header = ResponseHeader(code, version)
 
         self.clientID = b""
         self.contentSize = INIT_VALUE
@@ -305,12 +538,12 @@ class SendFileResponse:
     """ Response header and file information including the CRC value, little endian pack function. """
     def pack(self):
         try:
-            data = self.header.pack()
-            data += struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
-            data += struct.pack("<I", self.contentSize)
-            data += struct.pack(f"<{NAME_SIZE}s", self.fileName)
-            data += struct.pack("<I", self.cksum)
-            return data
+            payload = struct.pack(f"<{CLIENT_ID_SIZE}s", self.clientID)
+            payload += packSize(self.contentSize, self.header.version)
+            payload += packName(self.fileName, self.header.version)
+            payload += struct.pack("<I", self.cksum)
+            self.header.payload_size = len(payload)
+            return self.header.pack() + payload
         except:
             return b""
 
@@ -328,8 +561,7 @@ class CrcRequest:
         if not self.header.unpack(data):
             return False
         try:
-            requested_name = data[self.header.size:self.header.size + NAME_SIZE]
-            self.fileName = str(struct.unpack(f"<{NAME_SIZE}s", requested_name)[0].partition(b'\0')[0].decode('utf-8'))
+            self.fileName = unpackName(data, self.header.size, self.header.version)[0]
             return True
         except:
             self.fileName = b""
@@ -355,8 +587,8 @@ class FinalInvalidCrcRequest(CrcRequest):
 
 
 class MessageDeliveredResponse:
-    def __init__(self):
-        self.header = ResponseHeader(ServerResponseCode.RESPONSE_MESSAGE_DELIVERED.value)
+    def __init__(self, version=SERVER_VERSION):
+        self.header = ResponseHeader(ServerResponseCode.RESPONSE_MESSAGE_DELIVERED.value, version)
         self.clientID = b""
 
     """ Response header and client ID endian pack function. """
@@ -367,3 +599,118 @@ class MessageDeliveredResponse:
             return data
         except:
             return b""
+
+
+""" The function unpacks count chunk hashes at the offset, raises ValueError if the data is shorter. """
+def unpackHashes(data, offset, count):
+    end = offset + count * CHUNK_HASH_SIZE
+    if len(data) < end:
+        raise ValueError("Chunk hashes are longer than the data")
+    return [bytes(data[i:i + CHUNK_HASH_SIZE]) for i in range(offset, end, CHUNK_HASH_SIZE)]
+
+
+""" Query chunks request, the client asks which of the chunks (by hash) the server does not have. """
+
+
+class QueryChunksRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.hashes = []
+
+    """ Request header, hashes count and the hashes little endian unpack function. """
+    def unpack(self, data):
+        if not self.header.unpack(data):
+            return False
+        try:
+            count = struct.unpack("<I", data[self.header.size:self.header.size + PAYLOAD_SIZE])[0]
+            if count > MAX_QUERY_CHUNKS:
+                return False
+            self.hashes = unpackHashes(data, self.header.size + PAYLOAD_SIZE, count)
+            return True
+        except:
+            self.hashes = []
+            return False
+
+
+""" Chunks missing response, a bit for every hash of the query or of the chunked file (least significant bit first), set 
+    if the server does not have the chunk. """
+
+
+class ChunksMissingResponse:
+    def __init__(self, version=SERVER_VERSION):
+        self.header = ResponseHeader(ServerResponseCode.RESPONSE_CHUNKS_MISSING.value, version)
+        self.clientID = b""
+        self.missing = []
+
+    """ Response header, client ID, hashes count and the bitmap little endian pack function. """
+    def pack(self):
+        try:
+            bitmap = bytearray((len(self.missing) + 7) // 8)
+            for i, missing in enumerate(self.missing):
+                if missing:
+                    bitmap[i // 8] |= 1 << (i % 8)
+            payload = struct.pack(f"<{CLIENT_ID_SIZE}sI", self.clientID, len(self.missing)) + bytes(bitmap)
+            self.header.payload_size = len(payload)
+            return self.header.pack() + payload
+        except:
+            return b""
+
+
+""" Send chunk request, one encrypted chunk of a file (CBC, or GCM nonce, cipher and tag). There is no response, the 
+    chunk is used by the send chunked file request that follows. """
+
+
+class SendChunkRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.content = b""
+        self.compression = Compression.NONE.value
+
+    """ Request header, content size, compression (compressed chunk request) and the encrypted content little endian 
+        unpack function. """
+    def unpack(self, data):
+        if not self.header.unpack(data):
+            return False
+        try:
+            content_size, offset = unpackSize(data, self.header.size, self.header.version)
+            if isCompressed(self.header.code):
+                self.compression = data[offset]
+                offset += COMPRESSION_SIZE
+            self.content = bytes(data[offset:offset + content_size])
+            return len(self.content) == content_size
+        except:
+            self.content = b""
+            return False
+
+
+""" Send chunked file request, the file is made of the chunks of the hashes, in their order. """
+
+
+class SendChunkedFileRequest:
+    def __init__(self):
+        self.header = RequestHeader()
+        self.contentSize = INIT_VALUE
+        self.fileName = b""
+        self.hashes = []
+        self.cksum = None  # CRC value of the client, commit requests only
+
+    """ Request header, file size, file name, hashes count, the hashes and the CRC value (commit request) little endian 
+        unpack function. """
+    def unpack(self, data):
+        if not self.header.unpack(data):
+            return False
+        try:
+            self.contentSize, offset = unpackSize(data, self.header.size, self.header.version)
+            self.fileName, offset = unpackName(data, offset, self.header.version)
+            count = struct.unpack("<I", data[offset:offset + PAYLOAD_SIZE])[0]
+            self.hashes = unpackHashes(data, offset + PAYLOAD_SIZE, count)
+            if isCommit(self.header.code):
+                offset += PAYLOAD_SIZE + count * CHUNK_HASH_SIZE
+                self.cksum = struct.unpack("<I", data[offset:offset + CRC_SIZE])[0]
+            return True
+        except:
+            self.contentSize = INIT_VALUE
+            self.fileName = b""
+            self.hashes = []
+            self.cksum = None
+            return False
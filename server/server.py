@@ -4,16 +4,19 @@ import logging
 import selectors
 import database
 import request
+import chunkstore
+import ticket
+import connection
+import workers
 import uuid
 import base64
 import os  # for file path
-import zlib  # crc calculation
+import sqlite3
+import signal
+import time
 
 from datetime import datetime
-from Crypto.Cipher import AES, PKCS1_OAEP
 from Crypto.Random import get_random_bytes
-from Crypto.PublicKey import RSA
-from Crypto.Util.Padding import unpad
 
 
 """ Server class """
@@ -21,17 +24,31 @@ from Crypto.Util.Padding import unpad
 
 class Server:
     DATABASE = 'server.db'
+    CHUNK_STORE = '.chunks'  # directory of the chunk store, usernames can not start with a dot
+    TICKET_KEY = 'ticket.key'  # key of the session tickets, delete it to make all the tickets invalid
     PACKET_SIZE = 1024      # packet size.
-    MAX_QUEUED_CONN = 10    # maximum of connections
+    MAX_QUEUED_CONN = socket.SOMAXCONN  # maximum of connections waiting to be accepted, by default
+    LISTENERS = 1           # processes that accept and serve the connections, by default
+    LISTENER_MIN_UPTIME = 10  # seconds a listener runs for its exit not to count as a failed start
+    LISTENER_MAX_FAILURES = 5  # failed starts in a row of a listener, the server stops after them
+    LISTENER_POLL = 0.1     # seconds between the checks for exited listeners, while one waits to start again
     IS_BLOCKING = False     # not blocking
+    PENDING = object()      # returned by a handler whose request completes when its job on the workers completed
 
     """ Initialization of the server"""
-    def __init__(self, host, port):
+    def __init__(self, host, port, listeners=LISTENERS, backlog=MAX_QUEUED_CONN):
         logging.basicConfig(format='[%(levelname)s - %(asctime)s]: %(message)s', level=logging.INFO, datefmt='%H:%M:%S')
         self.host = host
         self.port = port
-        self.sel = selectors.DefaultSelector()              # Selector
+        self.listeners = listeners                          # Listener processes, see start
+        self.lastErr = None                                 # Reason the server did not start or stopped
+        self.backlog = backlog                              # Connections waiting to be accepted, on every listener
+        self.sel = None                                     # Selector, of the listener process
+        self.connections = {}                               # Received bytes and state of the next request, by socket
         self.database = database.Database(Server.DATABASE)  # Database initialization
+        self.chunkStore = chunkstore.ChunkStore(Server.CHUNK_STORE)  # Chunks of the files, kept once by their hash
+        self.tickets = ticket.SessionTickets(Server.TICKET_KEY)     # Session tickets, resumption without RSA
+        self.workers = None                                 # Processes of the CPU heavy stages, of the listener process
         self.requestHandle = {                              # Request mapping by codes and handle functions
             request.ClientRequestCode.REQUEST_REGISTRATION.value: self.handleRegistrationRequest,
             request.ClientRequestCode.REQUEST_SEND_PUBLIC_KEY.value: self.handleKeyExchangeRequest,
@@ -39,73 +56,297 @@ class Server:
             request.ClientRequestCode.REQUEST_SEND_FILE.value: self.handleSendFileRequest,
             request.ClientRequestCode.REQUEST_VALID_CRC.value: self.handleValidCRCRequest,
             request.ClientRequestCode.REQUEST_INVALID_CRC.value: self.handleInvalidCRCRequest,
-            request.ClientRequestCode.REQUEST_FINAL_INVALID_CRC.value: self.handleFinalInvalidCRCRequest
+            request.ClientRequestCode.REQUEST_FINAL_INVALID_CRC.value: self.handleFinalInvalidCRCRequest,
+            request.ClientRequestCode.REQUEST_QUERY_CHUNKS.value: self.handleQueryChunksRequest,
+            request.ClientRequestCode.REQUEST_SEND_CHUNK.value: self.handleSendChunkRequest,
+            request.ClientRequestCode.REQUEST_SEND_CHUNKED_FILE.value: self.handleSendChunkedFileRequest,
+            request.ClientRequestCode.REQUEST_SEND_FILE_GCM.value: self.handleSendFileRequest,
+            request.ClientRequestCode.REQUEST_SEND_CHUNK_GCM.value: self.handleSendChunkRequest,
+            request.ClientRequestCode.REQUEST_COMMIT_FILE_GCM.value: self.handleSendFileRequest,
+            request.ClientRequestCode.REQUEST_COMMIT_CHUNKED_FILE.value: self.handleSendChunkedFileRequest,
+            request.ClientRequestCode.REQUEST_COMMIT_COMPRESSED_FILE_GCM.value: self.handleSendFileRequest,
+            request.ClientRequestCode.REQUEST_SEND_COMPRESSED_CHUNK_GCM.value: self.handleSendChunkRequest,
+            request.ClientRequestCode.REQUEST_RESUME_SESSION.value: self.handleResumeSessionRequest
         }
 
-    """ The function accepts connection from client. """
+    """ The function accepts the connections that wait on the listening socket. """
     def accept(self, sock, mask):
-        conn, address = sock.accept()
-        conn.setblocking(Server.IS_BLOCKING)
-        self.sel.register(conn, selectors.EVENT_READ, self.read)
-
-    """ The function reads data from client and parsing it."""
+        while True:
+            try:
+                conn, address = sock.accept()
+            except (BlockingIOError, InterruptedError):
+                return
+            except OSError as e:  # out of descriptors and alike, the next event tries again
+                logging.error(f"Failed to accept connection: {e}")
+                return
+            conn.setblocking(Server.IS_BLOCKING)
+            self.connections[conn] = connection.Connection(conn, self.beginUpload)
+            self.sel.register(conn, selectors.EVENT_READ, self.ready)
+
+    """ The function handles the events of the connection: sends the responses that wait for the socket and receives 
+        what arrived. """
+    def ready(self, conn, mask):
+        client = self.connections[conn]
+        if mask & selectors.EVENT_WRITE:
+            if not client.flush():
+                logging.error(f"Failed to send response to {conn}")
+                self.close(conn)
+                return
+            if client.closing and not client.outgoing:
+                self.close(conn)
+                return
+            self.updateEvents(conn, client)
+        if mask & selectors.EVENT_READ and not client.closing:
+            self.read(conn, mask)
+
+    """ The function reads data from client and parsing it. Every read event receives only what arrived, the request is 
+        handled once its whole frame is there (see connection.Connection), so a slow or big upload does not hold the 
+        other clients. v4 clients may keep the connection open for a whole session (key exchange, file and CRC 
+        requests), the connection is closed when the client closes it, after a v3 request or after an error."""
     def read(self, conn, mask):
-        data = conn.recv(Server.PACKET_SIZE)
-        if data:
-            requestHeader = request.RequestHeader()
-            success = False
-            if not requestHeader.unpack(data):
-                logging.error("Failed to parse request header!")
+        client = self.connections[conn]
+        if not client.receive():  # client closed the connection
+            self.close(conn)
+            return
+        self.process(conn, client)
+
+    """ The function handles the requests of the connection whose frames arrived and sends their responses. A request 
+        whose job runs on the workers holds the next requests until it completed, and the requests after chunks wait for 
+        the chunks to be stored. While the connection is busy with the workers or its responses it does not receive, so 
+        a client can not queue more than the workers and the socket take."""
+    def process(self, conn, client):
+        if client.closing:
+            return
+        while not client.pending:
+            if client.held is not None:
+                if client.jobs:
+                    break
+                frame, client.held = client.held, None
             else:
-                if requestHeader.code in self.requestHandle.keys():
-                    success = self.requestHandle[requestHeader.code](conn, data)  # corresponding handle function.
-
-            if not success:  # Return general error
-                responseHeader = request.ResponseHeader(request.ServerResponseCode.RESPONSE_SERVER_ERROR.value)
-                self.write(conn, responseHeader.pack())
+                try:
+                    frame = client.nextFrame()
+                except ValueError as e:
+                    logging.error(f"Failed to receive request: {e}")
+                    self.respondError(conn, client.header)
+                    self.close(conn)
+                    return
+                if frame is None:  # rest of the request did not arrive yet
+                    break
+                if client.jobs and not request.isChunk(frame[0].code):
+                    client.held = frame
+                    break
+            requestHeader, data = frame
+            if not self.handleRequest(conn, requestHeader, data):
+                self.close(conn)
+                return
+
+        if not client.flush():
+            logging.error(f"Failed to send response to {conn}")
+            self.close(conn)
+            return
+        self.updateEvents(conn, client)
+
+    """ The function registers the connection for the events it waits for: receiving while it is not busy (see 
+        connection.Connection.busy) or closing, and sending while responses wait for the socket. """
+    def updateEvents(self, conn, client):
+        events = 0 if client.busy() or client.closing else selectors.EVENT_READ
+        if client.outgoing:
+            events |= selectors.EVENT_WRITE
+        if events == client.events:
+            return
+        if not client.events:
+            self.sel.register(conn, events, self.ready)
+        elif not events:
+            self.sel.unregister(conn)
+        else:
+            self.sel.modify(conn, events, self.ready)
+        client.events = events
+
+    """ The function handles a single request, returns whether the connection stays open for the next request. """
+    def handleRequest(self, conn, requestHeader, data):
+        handler = self.requestHandle.get(requestHeader.code)
+        return self.completeRequest(conn, requestHeader, lambda: handler is not None and handler(conn, data))
+
+    """ The function completes the request by the given step (its handler, or the completion of its job): the writes 
+        of the request to the database are committed together, before its responses are sent. A request that failed 
+        rolls back its writes and drops its responses for general error. Returns whether the connection stays open for 
+        the next request."""
+    def completeRequest(self, conn, requestHeader, step):
+        client = self.connections[conn]
+        queued = len(client.outgoing)  # the responses of the request are queued after it
+        with self.database.transaction():
+            try:
+                success = step()
+            except Exception as e:
+                logging.error(f"Failed to handle request: {e}")
+                success = False
+            if success is Server.PENDING:  # completed by its job, see defer
+                return True
+            if not success:
+                self.database.rollback()
             self.database.setLastSeen(requestHeader.clientID, str(datetime.now()))
-        self.sel.unregister(conn)
+        if not success:  # Return general error
+            client.drop(queued)
+            self.respondError(conn, requestHeader)
+        return success and request.isCompact(requestHeader.version)
+
+    """ The function defers the request to the completion of its job on the workers, the handler submits the job with 
+        the returned callback and returns PENDING. completion(result, error) is called on the event loop when the job 
+        completed, it responds and returns whether the request succeeded. The next requests of the connection wait for 
+        it. """
+    def defer(self, conn, requestHeader, completion):
+        client = self.connections[conn]
+        client.pending = True
+
+        def completed(result, error):
+            if self.connections.get(conn) is not client or client.closing:  # the client closed the connection meanwhile
+                return
+            client.pending = False
+            if not self.completeRequest(conn, requestHeader, lambda: completion(result, error)):
+                self.close(conn)
+                return
+            self.process(conn, client)
+        return completed
+
+    """ The function calls the callbacks of the jobs that completed on the workers. """
+    def complete(self, pool, mask):
+        pool.dispatch()
+
+    """ The function responds with general error, in the version of the request if its header arrived. """
+    def respondError(self, conn, requestHeader):
+        if requestHeader is None:
+            requestHeader = request.RequestHeader()
+        responseHeader = request.ResponseHeader(request.ServerResponseCode.RESPONSE_SERVER_ERROR.value,
+                                                requestHeader.version)
+        self.write(conn, responseHeader.pack(), not request.isCompact(responseHeader.version))
+
+    """ The function closes client connection. The responses that wait for the socket are sent first, the connection 
+        does not receive meanwhile and is closed once they were sent. """
+    def close(self, conn):
+        client = self.connections.get(conn)
+        if client is None:
+            conn.close()
+            return
+        if client.flush() and client.outgoing:
+            client.closing = True
+            self.updateEvents(conn, client)
+            return
+        del self.connections[conn]
+        client.close()
+        if client.events:
+            self.sel.unregister(conn)
         conn.close()
 
-    """ The function sends response to the client ."""
-    def write(self, conn, data):
-        size = len(data)
-        sent = 0
-        while sent < size:
-            leftover = size - sent
-            if leftover > Server.PACKET_SIZE:
-                leftover = Server.PACKET_SIZE
-            toSend = data[sent:sent + leftover]
-            if len(toSend) < Server.PACKET_SIZE:
-                toSend += bytearray(Server.PACKET_SIZE - len(toSend))
-            try:
-                conn.send(toSend)
-                sent += len(toSend)
-            except:
-                logging.error("Failed to send response to " + conn)
-                return False
-        logging.info("Response sent successfully.")
+    """ The function queues the response to the client, it is sent when the request completed (see process). v3 
+        responses are padded to packets of PACKET_SIZE, v4 responses are sent in their exact size."""
+    def write(self, conn, data, padded=True):
+        if padded and len(data) % Server.PACKET_SIZE:
+            data = bytes(data) + bytes(Server.PACKET_SIZE - len(data) % Server.PACKET_SIZE)
+        if not self.connections[conn].send(data):
+            logging.error(f"Failed to send response to {conn}")
+            return False
+        logging.info("Response queued.")
         return True
 
-    """ The function is listening for connection"""
+    """ The function sends the response in the framing of its version. """
+    def respond(self, conn, response):
+        return self.write(conn, response.pack(), not request.isCompact(response.header.version))
+
+    """ The function is listening for connection. With more than one listener the server forks a process for every 
+        listener, each one has its own listening socket on the port (SO_REUSEPORT), so the kernel balances the new 
+        connections between them, and its own selector, database connection and workers. The processes share the 
+        database file (its cache is checked against the commits of the others, see database.Database.revalidate), the 
+        chunk store and the ticket key. The first process waits for the listeners and starts again the ones that exit, 
+        a listener that exits right after it started waits longer every time and stops the server after 
+        LISTENER_MAX_FAILURES times. Returns False if the server could not start listening or was stopped. """
     def start(self):
         self.database.initialize()
+        self.database.close()  # every listener opens its own connection
         try:
-            sock = socket.socket()
-            sock.bind((self.host, self.port))
-            sock.listen(Server.MAX_QUEUED_CONN)
-            sock.setblocking(Server.IS_BLOCKING)
-            self.sel.register(sock, selectors.EVENT_READ, self.accept)
+            sockets = [self.listen() for _ in range(self.listeners)]
         except Exception as e:
             logging.exception(f"Server main loop exception: {e}")
+            self.lastErr = e
             return False
         print(f"Server is listening for connections on port {self.port}..")
+        if len(sockets) == 1:
+            self.serve(sockets[0], workers.WorkerPool.WORKERS)
+        # Every listener gets its share of the cores for its workers.
+        worker_count = max(1, workers.WorkerPool.WORKERS // len(sockets))
+        listeners = {}  # index of every listener by its process ID
+        started = [0.0] * len(sockets)  # start time of every listener
+        restart = [0.0] * len(sockets)  # time every listener that exited is started again
+        failures = [0] * len(sockets)  # failed starts in a row of every listener
+        while True:
+            now = time.monotonic()
+            for index, sock in enumerate(sockets):
+                if index in listeners.values() or restart[index] > now:
+                    continue
+                pid = os.fork()
+                if pid == 0:
+                    for other in sockets:
+                        if other is not sock:
+                            other.close()
+                    try:
+                        self.serve(sock, worker_count)
+                    finally:
+                        os._exit(1)
+                listeners[pid] = index
+                started[index] = time.monotonic()
+            if len(listeners) < len(sockets):  # a listener waits to start again, the exits are checked meanwhile
+                pid, status = os.waitpid(-1, os.WNOHANG) if listeners else (0, 0)
+                if pid == 0:
+                    time.sleep(Server.LISTENER_POLL)
+                    continue
+            else:
+                pid, status = os.wait()
+            if pid not in listeners:
+                continue
+            index = listeners.pop(pid)
+            exit_code = os.waitstatus_to_exitcode(status)  # negative signal number if it was killed
+            if time.monotonic() - started[index] < Server.LISTENER_MIN_UPTIME:
+                failures[index] += 1
+            else:
+                failures[index] = 0
+            if failures[index] >= Server.LISTENER_MAX_FAILURES:
+                self.lastErr = f"Listener {index} exited ({exit_code}) {failures[index]} times right after it started"
+                logging.error(f"{self.lastErr}, stopping the server.")
+                for other in listeners:
+                    os.kill(other, signal.SIGTERM)
+                for other in listeners:
+                    os.waitpid(other, 0)
+                return False
+            delay = 2 ** failures[index] - 1  # 0 for a listener that ran, then 1, 3, 7 .. seconds
+            logging.error(f"Listener {index} exited ({exit_code}), starting it again in {delay} seconds.")
+            restart[index] = time.monotonic() + delay
+
+    """ The function returns a new listening socket on the port of the server. The address is reused (SO_REUSEADDR), so 
+        the server starts again right after it stopped, and with more than one listener the port is shared by them 
+        (SO_REUSEPORT). """
+    def listen(self):
+        sock = socket.socket()
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        if self.listeners > 1:
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+        sock.bind((self.host, self.port))
+        sock.listen(self.backlog)
+        sock.setblocking(Server.IS_BLOCKING)
+        return sock
+
+    """ The function serves the connections of the listening socket, it does not return. """
+    def serve(self, sock, worker_count):
+        self.sel = selectors.DefaultSelector()
+        self.workers = workers.WorkerPool(worker_count)
+        self.workers.warm()
+        self.sel.register(self.workers, selectors.EVENT_READ, self.complete)
+        self.sel.register(sock, selectors.EVENT_READ, self.accept)
         while True:
             try:
-                events = self.sel.select()
+                events = self.sel.select(database.Database.LAST_SEEN_INTERVAL)
                 for key, mask in events:
                     callback = key.data
                     callback(key.fileobj, mask)
+                self.database.flushLastSeen()
             except Exception as e:
                 logging.exception(f"Server main loop exception: {e}")
 
@@ -123,9 +364,9 @@ class Server:
                 return False
             if self.database.clientUsernameExists(client_request.name):
                 logging.info(f"Registration Request: Username ({client_request.name}) already exists.")
-                response = request.RegistrationFailureResponse()
+                response = request.RegistrationFailureResponse(client_request.header.version)
                 response.header.payload_size = 0  # No extra payload
-                return self.write(conn, response.pack())
+                return self.respond(conn, response)
 
         except:
             logging.error("Registration Request: Failed to connect to database.")
@@ -133,14 +374,21 @@ class Server:
         # Create client with a unique client ID in hexadecimal form
         client = database.Client(uuid.uuid4().hex, client_request.name, str(datetime.now()))
         # Store in to the database
-        if not self.database.storeClient(client):
+        try:
+            stored = self.database.storeClient(client)
+        except sqlite3.IntegrityError:  # registered meanwhile by another listener
+            logging.info(f"Registration Request: Username ({client_request.name}) already exists.")
+            response = request.RegistrationFailureResponse(client_request.header.version)
+            response.header.payload_size = 0  # No extra payload
+            return self.respond(conn, response)
+        if not stored:
             logging.error(f"Registration Request: Failed to store client {client_request.name}.")
             return False
         logging.info(f"Successfully registered client {client_request.name}.")
-        response = request.RegistrationSuccessResponse()
+        response = request.RegistrationSuccessResponse(client_request.header.version)
         response.clientID = client.ID
         response.header.payload_size = request.CLIENT_ID_SIZE
-        return self.write(conn, response.pack())
+        return self.respond(conn, response)
 
     """ The function handles key exchange process with the client, it receives client's public RSA key, generates AES
         key, encrypts it with client's public key, and sends encrypted public key back to the client."""
@@ -160,32 +408,40 @@ class Server:
                 logging.info(f"KeyExchange Request: Username({client_request.name}) does not exists.")
                 return False
             else:
-                self.database.setPublicKey(client_request.name, client_request.public_key)  # Save client's public key
-
-                """Generate AES key, encrypt it and build a message to send back."""
+                """Generate AES key, encrypt it on the workers and build a message to send back (see keyExchanged)."""
                 aes_key = get_random_bytes(16)
-                public_key = client_request.public_key
-                rsa_key = RSA.import_key(public_key)
-                cipher_rsa = PKCS1_OAEP.new(rsa_key)
-                encrypted_aes_key = cipher_rsa.encrypt(aes_key)
-
-                # Save clients AES key at the database and update last seen
-                self.database.setSymmetricKey(client_request.name, aes_key)
-                c_id = client_request.header.clientID
-                self.database.setLastSeen(c_id, str(datetime.now()))
-
-                # Prepare the response
-                response = request.KeyExchangeResponse()
-                response.clientID = c_id
-                response.encrypted_key = encrypted_aes_key
-                response.header.payload_size = request.CLIENT_ID_SIZE + len(response.encrypted_key)
-
-                return self.write(conn, response.pack())
+                done = self.defer(conn, client_request.header, lambda encrypted_aes_key, error: self.keyExchanged(
+                    conn, client_request, aes_key, encrypted_aes_key, error))
+                self.workers.submit(self.workers.worker(), done, workers.encryptKey, client_request.public_key, aes_key)
+                return Server.PENDING
 
         except:
             logging.error("KeyExchange Request: Failed to connect to database.")
             return False
 
+    """ The function completes key exchange once the AES key was encrypted by the public key of the client, saves both 
+        keys and responds with the encrypted key. A public key that is not valid is not saved. """
+    def keyExchanged(self, conn, client_request, aes_key, encrypted_aes_key, error):
+        if error is not None:
+            logging.error(f"KeyExchange Request: Failed to encrypt the key: {error}")
+            return False
+        self.database.setPublicKey(client_request.name, client_request.public_key)  # Save client's public key
+
+        # Save clients AES key at the database and update last seen
+        self.database.setSymmetricKey(client_request.name, aes_key)
+        c_id = client_request.header.clientID
+        self.database.setLastSeen(c_id, str(datetime.now()))
+
+        # Prepare the response
+        response = request.KeyExchangeResponse(client_request.header.version)
+        response.clientID = c_id
+        response.encrypted_key = encrypted_aes_key
+        if request.hasTickets(response.header.version):
+            response.ticket = self.tickets.issue(c_id, aes_key)
+        response.header.payload_size = request.CLIENT_ID_SIZE + len(response.encrypted_key) + len(response.ticket)
+
+        return self.respond(conn, response)
+
     """ The function handles reconnection process, once client registered he does not have to send hes public key every
         time he wants to send file to the server, he can request for reconnection. Reconnection process uses store 
         client public key, generates new AES key, encrypts it and send to the client. It also updates the database. """
@@ -202,109 +458,293 @@ class Server:
                 if c_key_pub is None:
                     logging.error(f"Reconnection Request: Public key not found. Username ({client_request.name}) have "
                                  f"not sent public key to the server.")
-                    response = request.ReconnectionDeniedResponse()
+                    response = request.ReconnectionDeniedResponse(client_request.header.version)
                     response.clientID = c_id
                     response.header.payload_size = request.CLIENT_ID_SIZE
-                    return self.write(conn, response.pack())
+                    return self.respond(conn, response)
 
                 else:  # There is public key for this user, no need to exchange keys.
-                    # Generate new private AES key, encrypt it and send to the user.
+                    # Generate new private AES key, encrypt it on the workers and send to the user (see reconnected).
                     aes_key = get_random_bytes(16)
-                    public_key = self.database.getClientPublicKey(c_id)
-                    rsa_key = RSA.import_key(public_key)
-                    cipher_rsa = PKCS1_OAEP.new(rsa_key)
-                    encrypted_aes_key = cipher_rsa.encrypt(aes_key)
-
-                    # Update the new symmetric key and last seen
-                    self.database.setSymmetricKey(client_request.name, aes_key)
-                    self.database.setLastSeen(c_id, str(datetime.now()))
-                    # Response preparation
-                    response = request.ReconnectionAcceptResponse()
-                    response.clientID = c_id
-                    response.encrypted_key = encrypted_aes_key
-                    response.header.payload_size = request.CLIENT_ID_SIZE + len(response.encrypted_key)
-                    return self.write(conn, response.pack())
+                    done = self.defer(conn, client_request.header, lambda encrypted_aes_key, error: self.reconnected(
+                        conn, client_request, aes_key, encrypted_aes_key, error))
+                    self.workers.submit(self.workers.worker(), done, workers.encryptKey, c_key_pub, aes_key)
+                    return Server.PENDING
 
             else:       # Username do not exist
                 logging.error(f"Reconnection Request: Username ({client_request.name}) does not exist.")
-                response = request.ReconnectionDeniedResponse()     # Response with reconnection denied.
+                response = request.ReconnectionDeniedResponse(client_request.header.version)     # Response with reconnection denied.
                 response.clientID = client_request.header.clientID
                 response.header.payload_size = request.CLIENT_ID_SIZE
-                return self.write(conn, response.pack())
+                return self.respond(conn, response)
 
         except:
             logging.error("Reconnection Request: Failed to connect to database.")
             return False
 
+    """ The function completes reconnection once the new AES key was encrypted by the stored public key of the client,
+        saves the key and responds with the encrypted key. """
+    def reconnected(self, conn, client_request, aes_key, encrypted_aes_key, error):
+        if error is not None:
+            logging.error(f"Reconnection Request: Failed to encrypt the key: {error}")
+            return False
+        c_id = client_request.header.clientID
+
+        # Update the new symmetric key and last seen
+        self.database.setSymmetricKey(client_request.name, aes_key)
+        self.database.setLastSeen(c_id, str(datetime.now()))
+        # Response preparation
+        response = request.ReconnectionAcceptResponse(client_request.header.version)
+        response.clientID = c_id
+        response.encrypted_key = encrypted_aes_key
+        if request.hasTickets(response.header.version):
+            response.ticket = self.tickets.issue(c_id, aes_key)
+        response.header.payload_size = request.CLIENT_ID_SIZE + len(response.encrypted_key) + len(response.ticket)
+        return self.respond(conn, response)
+
+    """ The function handles resume session request, the reconnection of a client that has a session ticket. The ticket 
+        is opened by the ticket key of the server and the new symmetric key is derived from its resumption secret and the 
+        nonces of the client and the server, no RSA encryption. The response carries a new ticket of the new key (with 
+        the issue time of the presented ticket). A ticket that is not valid or expired is answered with reconnection 
+        denied, the client reconnects with RSA then. """
+    def handleResumeSessionRequest(self, conn, data):
+        client_request = request.ResumeSessionRequest()
+        if not client_request.unpack(data):
+            logging.error("Resume session Request: Failed parsing request.")
+            return False
+        logging.info("Resume session request received.")
+
+        c_id = client_request.header.clientID
+        opened = self.tickets.open(c_id, client_request.ticket)
+        if opened is None or not self.database.clientIdExists(c_id):
+            logging.info("Resume session Request: Ticket is not valid or expired.")
+            response = request.ReconnectionDeniedResponse(client_request.header.version)
+            response.clientID = c_id
+            response.header.payload_size = request.CLIENT_ID_SIZE
+            return self.respond(conn, response)
+
+        secret, issued = opened
+        server_nonce = get_random_bytes(request.RESUME_NONCE_SIZE)
+        aes_key = ticket.SessionTickets.deriveKey(secret, client_request.nonce, server_nonce)
+        self.database.setClientSymKey(c_id, aes_key)
+
+        response = request.SessionResumedResponse(client_request.header.version)
+        response.clientID = c_id
+        response.nonce = server_nonce
+        response.ticket = self.tickets.issue(c_id, aes_key, issued)
+        return self.respond(conn, response)
+
     """ The function handles send file request. It receives the request from the client with the encrypted file, it 
         decrypt the file with AES key which set up previously with the user. The function calculates CRC value for 
         decrypted file and saves the file in users directory. The function also updates the file table with file details
-        and sends response to the user with the CRC value to check if the file that received arrived properly. """
+        and sends response to the user with the CRC value to check if the file that received arrived properly. Commit 
+        request carries the CRC value of the client too, the file is verified at once (see fileDelivered). Compressed 
+        content is decompressed after the decryption, CRC value is of the file itself. """
     def handleSendFileRequest(self, conn, data):
         client_request = request.FileSendRequest()
+        file_upload = self.connections[conn].takeUpload()
 
-        if not client_request.unpack(conn, data):
+        if not client_request.unpack(data):
             logging.error("Send file Request: Failed parsing request.")
+            file_upload.abort()
             return False
 
         logging.info("Send file request received.")
-        if not self.database.clientIdExists(client_request.header.clientID):
-            logging.error(f"Send file Request: Client does not exists.")
+        # The content was decrypted, checked by CRC and written to the file by the worker while it arrived.
+        file_upload.finish(self.defer(conn, client_request.header, lambda result, error: self.fileUploaded(
+            conn, client_request, result, error)))
+        return Server.PENDING
+
+    """ The function completes send file request once its upload completed on the worker. """
+    def fileUploaded(self, conn, client_request, result, error):
+        if error is not None:  # padding or authentication tag of content that did not arrive intact
+            logging.error(f"Send file Request: File content did not arrive intact: {error}")
             return False
+        content_size, crc_value = result
+        return self.fileDelivered(conn, client_request.header, client_request.fileName, content_size, crc_value,
+                                  client_request.cksum)
+
+    """ The function starts the upload of send file request once its header and fields arrived, the content is written 
+        to the file of the client while it arrives. An upload that can not start drops its content and the request 
+        fails when it ends. The connection stops receiving while the worker has enough batches of the upload, it goes on 
+        when they were processed. Raises ValueError if the fields are not valid, the connection is closed. """
+    def beginUpload(self, conn, header, data):
+        client_request = request.FileSendRequest()
+        if not client_request.unpack(data):
+            raise ValueError("Failed parsing send file request")
+        if request.isCompact(header.version) and header.payload_size != client_request.trailerOffset - header.size + \
+                client_request.contentSize + request.trailerSize(header.code):
+            raise ValueError(f"Payload size {header.payload_size} is not as the content size")
 
-        sym_key = self.database.getClientSymKey(client_request.header.clientID)
-
-        # IV used in the C++ code
-        iv = bytes([0] * AES.block_size)        # Initial vector of all zeros
-
-        # Create AES cipher object with key and IV
-        cipher = AES.new(sym_key, AES.MODE_CBC, iv=iv)
-
-        # Decrypt the encrypted file content
-        decrypted_content = cipher.decrypt(client_request.content)
-        # Remove padding
-        decrypted_content = unpad(decrypted_content, AES.block_size)
-        # Calculate CRC value
-        crc_value = zlib.crc32(decrypted_content)
-
-        #print(f"crc value: {crc_value}")
+        client = self.connections[conn]
 
-        # Create directory for clients files if not exist yet.
-        directory_name = self.database.getClientUsernameByID(client_request.header.clientID)
+        def resume():
+            if self.connections.get(conn) is client:
+                self.process(conn, client)
+        file_upload = workers.PooledUpload(self.workers, client_request.contentSize, resume)
+        try:
+            with self.database.transaction():  # the cached client is checked against the other listeners
+                if not self.database.clientIdExists(header.clientID):
+                    raise ValueError("Client does not exists")
+                file_size = client_request.fileSize if request.isCompressed(header.code) else None
+                file_upload.start(self.clientFilePath(header.clientID, client_request.fileName),
+                                  self.database.getClientSymKey(header.clientID), header.code,
+                                  client_request.compression, file_size)
+        except (ValueError, OSError) as e:
+            file_upload.fail(e)
+        return file_upload
+
+    """ The function returns the path of the file in the directory of the client, the directory is created if not exist 
+        yet. """
+    def clientFilePath(self, client_id, file_name):
+        directory_name = self.database.getClientUsernameByID(client_id)
         if not os.path.exists(directory_name):
             os.makedirs(directory_name)
+        return os.path.join(directory_name, file_name.encode('utf-8'))
 
-        file_path = os.path.join(directory_name, client_request.fileName.encode('utf-8'))
-
-        with open(file_path, 'wb') as f:
-            # Write the decrypted content to the file
-            f.write(decrypted_content)
-
-        file_path = os.path.abspath(client_request.fileName)
+    """ The function records the file that was written to the directory of the client at the file table and responds 
+        with the CRC value of the file, for the client to check that the file arrived properly. client_crc is the CRC 
+        value the client sent with a commit request: if it is the same, the file is stored verified and the response is 
+        file committed, the upload takes one round trip. Otherwise the file is not verified and the client goes on as for 
+        send file request (invalid CRC and sending the file again). """
+    def fileDelivered(self, conn, header, file_name, content_size, crc_value, client_crc=None):
+        file_path = os.path.abspath(file_name)
 
         if len(file_path) >= request.NAME_SIZE:
             logging.error(f"Send file Request: File path is to big.")
             return False
 
         # Create file object
-        file = database.File(client_request.header.clientID.hex(), client_request.fileName, file_path)
+        file = database.File(header.clientID.hex(), file_name, file_path)
+
+        committed = client_crc is not None and client_crc == crc_value
+        if client_crc is not None and not committed:
+            logging.error(f"Commit file Request: CRC value of {file_name} is not as the client calculated.")
 
         # If the file does not exist yet, save it.
         if not self.database.fileExists(file.ID, file.fileName):
-            if not self.database.storeFile(file, False):
-                logging.error(f"File sending request handling: Failed to store file {client_request.fileName}")
+            if not self.database.storeFile(file, committed):
+                logging.error(f"File sending request handling: Failed to store file {file_name}")
                 return False
+        elif client_crc is not None:
+            self.database.setVerified(file.ID, file.fileName, committed)
 
         # Prepare response
-        response = request.SendFileResponse()
+        code = request.ServerResponseCode.RESPONSE_FILE_COMMITTED.value if committed else \
+            request.ServerResponseCode.RESPONSE_FILE_DELIVERED_WITH_CRC.value
+        response = request.SendFileResponse(header.version, code)
+        response.clientID = header.clientID
+        response.contentSize = content_size
+        response.fileName = file_name.partition('\0')[0].encode('utf-8')
+        response.cksum = crc_value  # payload size is set while packing, the file name is in variable size
+
+        return self.respond(conn, response)
+
+    """ The function handles query chunks request, the client sends hashes of the chunks of a file and the server responds 
+        which of them it does not have, only these chunks are sent by the client. """
+    def handleQueryChunksRequest(self, conn, data):
+        client_request = request.QueryChunksRequest()
+        if not client_request.unpack(data):
+            logging.error("Query chunks Request: Failed parsing request.")
+            return False
+
+        if not self.database.clientIdExists(client_request.header.clientID):
+            logging.error(f"Query chunks Request: Client does not exists.")
+            return False
+
+        response = request.ChunksMissingResponse(client_request.header.version)
+        response.clientID = client_request.header.clientID
+        response.missing = [not self.chunkStore.has(client_request.header.clientID, chunk_hash)
+                            for chunk_hash in client_request.hashes]
+        logging.info(f"Query chunks request received, {sum(response.missing)} of {len(response.missing)} chunks "
+                     f"missing.")
+        return self.respond(conn, response)
+
+    """ The function handles send chunk request, the chunk is decrypted (and decompressed) and kept in the chunk store 
+        under the hash of its content. No response, a chunk that did not arrive intact is not found by its hash and sent 
+        again. """
+    def handleSendChunkRequest(self, conn, data):
+        client_request = request.SendChunkRequest()
+        if not client_request.unpack(data):
+            logging.error("Send chunk Request: Failed parsing request.")
+            return False
+
+        if not self.database.clientIdExists(client_request.header.clientID):
+            logging.error(f"Send chunk Request: Client does not exists.")
+            return False
+
+        # The chunk is stored by a worker, the next chunks of the connection go to the other workers meanwhile.
+        client = self.connections[conn]
+        client.jobs += 1
+
+        def stored(chunk_hash, error):
+            client.jobs -= 1
+            if isinstance(error, ValueError):  # padding or tag of a damaged chunk, it is reported missing later
+                logging.error("Send chunk Request: Chunk did not arrive intact, dropped.")
+            elif error is not None:
+                logging.error(f"Send chunk Request: Failed to store chunk: {error}")
+            if self.connections.get(conn) is client:
+                self.process(conn, client)
+        self.workers.submit(self.workers.worker(), stored, workers.storeChunk, Server.CHUNK_STORE,
+                            client_request.header.clientID,
+                            self.database.getClientSymKey(client_request.header.clientID), client_request.header.code,
+                            client_request.compression, client_request.content)
+        return True
+
+    """ The function handles send chunked file request. The file is assembled from the chunks in the chunk store, into 
+        the directory of the client, the response is the same as for send file request (and commit chunked file request 
+        as for commit file request). """
+    def handleSendChunkedFileRequest(self, conn, data):
+        client_request = request.SendChunkedFileRequest()
+        if not client_request.unpack(data):
+            logging.error("Send chunked file Request: Failed parsing request.")
+            return False
+
+        logging.info(f"Send chunked file request received, {len(client_request.hashes)} chunks.")
+        client_id = client_request.header.clientID
+        if not self.database.clientIdExists(client_id):
+            logging.error(f"Send chunked file Request: Client does not exists.")
+            return False
+
+        # Chunks that did not arrive intact are answered with chunks missing response (over the chunks of the file), the client 
+        # sends only them and the send chunked file request again.
+        missing = [not self.chunkStore.has(client_id, chunk_hash) for chunk_hash in client_request.hashes]
+        if any(missing):
+            return self.respondChunksMissing(conn, client_request, missing)
+
+        # The file is assembled by a worker (see fileAssembled).
+        file_path = self.clientFilePath(client_id, client_request.fileName)
+        done = self.defer(conn, client_request.header, lambda result, error: self.fileAssembled(
+            conn, client_request, result, error))
+        self.workers.submit(self.workers.worker(), done, workers.assembleFile, Server.CHUNK_STORE, client_id,
+                            client_request.hashes, file_path)
+        return Server.PENDING
+
+    """ The function responds with the chunks of the file that are missing, the client sends only them. """
+    def respondChunksMissing(self, conn, client_request, missing):
+        logging.info(f"Send chunked file request: {sum(missing)} chunks of {client_request.fileName} are missing.")
+        response = request.ChunksMissingResponse(client_request.header.version)
         response.clientID = client_request.header.clientID
-        response.contentSize = len(decrypted_content)
-        response.fileName = client_request.fileName.partition('\0')[0].encode('utf-8')
-        response.cksum = crc_value
-        response.header.payload_size = request.CLIENT_ID_SIZE + request.PAYLOAD_SIZE + request.NAME_SIZE \
-                                       + request.PAYLOAD_SIZE
+        response.missing = missing
+        return self.respond(conn, response)
+
+    """ The function completes send chunked file request once the file was assembled on the worker. The chunks that 
+        were damaged in the chunk store are missing. """
+    def fileAssembled(self, conn, client_request, result, error):
+        if error is not None:
+            logging.error(f"Send chunked file Request: Failed to assemble the file: {error}")
+            return False
+        content_size, crc_value, damaged = result
+        missing = [chunk_hash in damaged for chunk_hash in client_request.hashes]
+        if any(missing):
+            return self.respondChunksMissing(conn, client_request, missing)
+
+        if content_size != client_request.contentSize:
+            logging.error(f"Send chunked file Request: File size {content_size} is not as expected.")
+            return False
 
-        return self.write(conn, response.pack())
+        return self.fileDelivered(conn, client_request.header, client_request.fileName, content_size, crc_value,
+                                  client_request.cksum)
 
     """ The function handles valid crc request, in case the crc calculated right in send file function. The function 
         sets verified parameter at the database for corresponding file and responds to the user with right message."""
@@ -324,11 +764,11 @@ class Server:
         # CRC value verified, update on database
         self.database.setVerified(client_request.header.clientID, client_request.fileName, True)
         # Build response message
-        response = request.MessageDeliveredResponse()
+        response = request.MessageDeliveredResponse(client_request.header.version)
         response.clientID = client_request.header.clientID
         response.header.payload_size = request.CLIENT_ID_SIZE
 
-        return self.write(conn, response.pack())
+        return self.respond(conn, response)
 
     """ The function handle invalid CRC request, in case the CRC calculated wrong."""
     def handleInvalidCRCRequest(self, conn, data):
@@ -367,11 +807,11 @@ class Server:
             print(f"Error while tried deleting file: {e.strerror}")
 
         # Build response message
-        response = request.MessageDeliveredResponse()
+        response = request.MessageDeliveredResponse(client_request.header.version)
         response.clientID = client_request.header.clientID
         response.header.payload_size = request.CLIENT_ID_SIZE
 
-        return self.write(conn, response.pack())
+        return self.respond(conn, response)
 
 
 """ The function stops the server and shows informative error message."""
@@ -392,3 +832,21 @@ def parsePort(filepath):
         port = None
     finally:
         return port
+
+
+""" The function parsing the filepath, reading the second line: the number of listener processes and optionally the 
+    backlog of every listener, separated by a space. Returns them as integers, None for the ones that are not there. """
+def parseListeners(filepath):
+    listeners, backlog = None, None
+    try:
+        with open(filepath, "r") as port_info:
+            port_info.readline()
+            values = port_info.readline().split()
+            if values:
+                listeners = int(values[0])
+            if len(values) > 1:
+                backlog = int(values[1])
+    except (ValueError, FileNotFoundError):
+        listeners, backlog = None, None
+    finally:
+        return listeners, backlog
@@ -0,0 +1,83 @@
+import os
+import hmac
+import time
+import struct
+import hashlib
+
+from Crypto.Cipher import AES
+from Crypto.Random import get_random_bytes
+
+""" Session tickets class. A ticket is issued with every new symmetric key, it is the client ID, the issue time and the
+    resumption secret (the key itself) sealed by AES-GCM with the ticket key of the server, only the server can open it.
+    The client presents the ticket with a nonce of its own to resume the session: the new symmetric key is derived from
+    the secret and both nonces, without the RSA encryption of a reconnection. The server keeps no state of the tickets,
+    the ticket key is kept in a file so the tickets stay valid after the server restarts. """
+
+
+class SessionTickets:
+    KEY_SIZE = 16  # AES-128 ticket key
+    NONCE_SIZE = 12
+    TAG_SIZE = 16
+    SECRET_SIZE = 16  # resumption secret, the symmetric key the ticket was issued with
+    PLAIN_FORMAT = "<16sQ16s"  # client ID, issue time (seconds since the epoch), resumption secret
+    TICKET_SIZE = NONCE_SIZE + struct.calcsize(PLAIN_FORMAT) + TAG_SIZE
+    LIFETIME = 24 * 60 * 60  # seconds from the RSA key exchange or reconnection, resumed tickets keep the issue time
+    CLOCK_SKEW = 60  # seconds a ticket may be issued in the future (clock of the server was set back)
+    KEY_LABEL = b"session resumption"  # derivation of the resumed symmetric key
+
+    def __init__(self, key_path):
+        self.key = SessionTickets.loadKey(key_path)
+
+    """ The function reads the ticket key from the file, a new key is generated and written if there is no valid one. """
+    @staticmethod
+    def loadKey(key_path):
+        try:
+            with open(key_path, 'rb') as f:
+                key = f.read()
+            if len(key) == SessionTickets.KEY_SIZE:
+                return key
+        except OSError:
+            pass
+        key = get_random_bytes(SessionTickets.KEY_SIZE)
+        temp_path = f"{key_path}.{os.getpid()}.tmp"
+        fd = os.open(temp_path, os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o600)
+        with os.fdopen(fd, 'wb') as f:
+            f.write(key)
+        os.replace(temp_path, key_path)
+        return key
+
+    """ The function issues a ticket of the client for the resumption secret. issued is the issue time of the ticket
+        that was resumed, a new ticket is issued now. """
+    def issue(self, client_id, secret, issued=None):
+        if issued is None:
+            issued = int(time.time())
+        nonce = get_random_bytes(SessionTickets.NONCE_SIZE)
+        cipher = AES.new(self.key, AES.MODE_GCM, nonce=nonce, mac_len=SessionTickets.TAG_SIZE)
+        sealed, tag = cipher.encrypt_and_digest(struct.pack(SessionTickets.PLAIN_FORMAT, client_id, issued, secret))
+        return nonce + sealed + tag
+
+    """ The function opens the ticket, returns the resumption secret and the issue time, or None if the ticket is not
+        intact, it is of another client or it expired. """
+    def open(self, client_id, ticket):
+        if len(ticket) != SessionTickets.TICKET_SIZE:
+            return None
+        nonce = ticket[:SessionTickets.NONCE_SIZE]
+        sealed = ticket[SessionTickets.NONCE_SIZE:-SessionTickets.TAG_SIZE]
+        cipher = AES.new(self.key, AES.MODE_GCM, nonce=nonce, mac_len=SessionTickets.TAG_SIZE)
+        try:
+            plain = cipher.decrypt_and_verify(sealed, ticket[-SessionTickets.TAG_SIZE:])
+        except ValueError:
+            return None
+        ticket_id, issued, secret = struct.unpack(SessionTickets.PLAIN_FORMAT, plain)
+        now = time.time()
+        if not hmac.compare_digest(ticket_id, client_id) or issued > now + SessionTickets.CLOCK_SKEW or \
+                now - issued > SessionTickets.LIFETIME:
+            return None
+        return secret, issued
+
+    """ The function derives the symmetric key of the resumed session: HMAC-SHA256 of the label and the nonces of the
+        client and the server by the resumption secret, the first 16 bytes. """
+    @staticmethod
+    def deriveKey(secret, client_nonce, server_nonce):
+        digest = hmac.new(secret, SessionTickets.KEY_LABEL + client_nonce + server_nonce, hashlib.sha256).digest()
+        return digest[:SessionTickets.SECRET_SIZE]
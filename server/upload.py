@@ -0,0 +1,176 @@
+import os
+import struct
+import zlib  # crc calculation and decompression
+
+import request
+from Crypto.Cipher import AES
+from Crypto.Util.Padding import unpad
+
+""" File upload class. The content of send file request is decrypted, decompressed, checked by CRC and written to the
+    file while it arrives, a record at a time: the connection receives the content straight into the record buffer of
+    the upload, so the memory of an upload is a record and not the size of the file. The file is written to a temporary
+    file and renamed once the whole content arrived intact, a failed upload does not replace the file of the client. An
+    upload that failed still receives the rest of its content, the request is answered after it as before. """
+
+
+class FileUpload:
+    CBC_BLOCK_SIZE = 64 * 1024  # AES-CBC content decrypted at once, a multiple of the AES block
+    OUTPUT_SIZE = 1024 * 1024  # decompressed bytes written at once
+
+    def __init__(self, content_size):
+        self.remaining = content_size  # bytes of the content that did not arrive yet
+        self.content_size = content_size
+        self.buffer = bytearray(request.GCM_RECORD_SIZE + request.GCM_TAG_SIZE)
+        self.view = memoryview(self.buffer)
+        self.filled = 0  # bytes of the buffer that wait for the rest of their record
+        self.capacity = len(self.buffer)
+        self.error = None  # reason the upload failed, the rest of the content is dropped
+        self.file = None
+        self.file_path = None
+        self.temp_path = None
+        self.gcm = False
+        self.prefix = None  # nonce prefix of the GCM records
+        self.index = 0  # index of the next GCM record
+        self.sym_key = None
+        self.cipher = None  # AES-CBC decryption, it keeps the chaining between the blocks
+        self.last_block = b""  # AES-CBC plain block kept back for the padding, until the content ends
+        self.decompressor = None
+        self.file_size = None  # size of the file before its compression, compressed requests only
+        self.size = 0
+        self.crc = 0
+
+    """ The function starts writing the upload to the file, in the mode of the request code. Raises ValueError if the
+        content can not be in the mode. """
+    def start(self, file_path, sym_key, code, compression=request.Compression.NONE.value, file_size=None):
+        if compression == request.Compression.ZLIB.value:
+            self.decompressor = zlib.decompressobj()
+        elif compression != request.Compression.NONE.value:
+            raise ValueError(f"Compression {compression} is not supported")
+        self.file_size = file_size
+
+        self.gcm = code in (request.ClientRequestCode.REQUEST_SEND_FILE_GCM.value,
+                            request.ClientRequestCode.REQUEST_COMMIT_FILE_GCM.value,
+                            request.ClientRequestCode.REQUEST_COMMIT_COMPRESSED_FILE_GCM.value)
+        if self.gcm:
+            if self.content_size < request.GCM_NONCE_PREFIX_SIZE + request.GCM_TAG_SIZE:
+                raise ValueError("GCM content is too short")
+        else:
+            if self.content_size == 0 or self.content_size % AES.block_size:
+                raise ValueError("CBC content is not in whole blocks")
+            self.cipher = AES.new(sym_key, AES.MODE_CBC, iv=bytes(AES.block_size))  # IV used in the C++ code
+            self.capacity = FileUpload.CBC_BLOCK_SIZE
+        self.sym_key = sym_key
+
+        self.file_path = file_path
+        self.temp_path = file_path + f".{os.getpid()}.tmp".encode('utf-8')
+        self.file = open(self.temp_path, 'wb')
+
+    """ The function fails the upload, the rest of its content is dropped. """
+    def fail(self, reason):
+        if self.error is None:
+            self.error = str(reason)
+        self.abort()
+
+    """ The function returns the part of the buffer the next bytes of the content are received into. """
+    def space(self):
+        if self.gcm and self.prefix is None:
+            target = request.GCM_NONCE_PREFIX_SIZE
+        else:
+            target = min(self.capacity, self.filled + self.remaining)
+        return self.view[self.filled:target]
+
+    """ The function takes size bytes that were received into space(), the record is opened once it is whole. """
+    def received(self, size):
+        self.filled += size
+        self.remaining -= size
+        if not self.filled or len(self.space()):
+            return  # record is not whole yet
+        if self.error is None:
+            try:
+                self.process(self.view[:self.filled])
+            except (ValueError, zlib.error, OSError) as e:
+                self.fail(e)
+        self.filled = 0
+
+    """ The function takes the bytes of the content that were received into another buffer, returns how many of them
+        belong to the content. """
+    def feed(self, data):
+        consumed = 0
+        with memoryview(data) as view:  # released before the caller removes the bytes
+            while self.remaining and consumed < len(view):
+                space = self.space()
+                size = min(len(space), len(view) - consumed)
+                space[:size] = view[consumed:consumed + size]
+                consumed += size
+                self.received(size)
+        return consumed
+
+    """ The function opens a whole record of the content and writes its plain content. GCM content is the nonce prefix 
+        and then the records, every one is the encrypted record and its tag. The nonce of a record is the prefix and its 
+        index (with the last record flag), so records can not be reordered, repeated or cut off. CBC content is 
+        decrypted in blocks of CBC_BLOCK_SIZE, the padding is removed at its end. """
+    def process(self, record):
+        if self.gcm:
+            if self.prefix is None:
+                self.prefix = bytes(record)
+                return
+            if len(record) <= request.GCM_TAG_SIZE:
+                raise ValueError("GCM record is too short")
+            last = request.GCM_LAST_RECORD if not self.remaining else 0
+            nonce = self.prefix + struct.pack("<I", self.index | last)
+            cipher = AES.new(self.sym_key, AES.MODE_GCM, nonce=nonce)
+            self.output(cipher.decrypt_and_verify(record[:-request.GCM_TAG_SIZE], record[-request.GCM_TAG_SIZE:]))
+            self.index += 1
+            return
+
+        plain = self.last_block + self.cipher.decrypt(record)
+        if self.remaining:
+            self.last_block = plain[-AES.block_size:]
+            self.output(plain[:-AES.block_size])
+        else:
+            self.output(unpad(plain, AES.block_size))
+
+    """ The function decompresses the plain content and writes it, checks that it is not bigger than the file. """
+    def output(self, plain):
+        while plain:
+            if self.decompressor is None:
+                content, plain = plain, b""
+            else:
+                if self.decompressor.eof:
+                    raise ValueError("Compressed content is bigger than expected")
+                content = self.decompressor.decompress(plain, FileUpload.OUTPUT_SIZE)
+                plain = self.decompressor.unconsumed_tail
+            if self.file_size is not None and self.size + len(content) > self.file_size:
+                raise ValueError("Compressed content is bigger than expected")
+            self.crc = zlib.crc32(content, self.crc)
+            self.size += len(content)
+            self.file.write(content)
+
+    """ The function completes the upload once all the content arrived: the file replaces the file of the client.
+        Returns the size and the CRC value of the file, raises ValueError if the content did not arrive intact. """
+    def finish(self):
+        if self.error is None and self.remaining:
+            self.fail("File content is cut off")
+        if self.error is None and self.decompressor is not None and \
+                (not self.decompressor.eof or self.decompressor.unused_data):
+            self.fail("Compressed content is cut off")
+        if self.error is None and self.file_size is not None and self.size != self.file_size:
+            self.fail(f"File size {self.size} is not as expected")
+        if self.error is not None:
+            raise ValueError(self.error)
+
+        self.file.close()
+        self.file = None
+        os.replace(self.temp_path, self.file_path)
+        return self.size, self.crc
+
+    """ The function drops the file of an upload that did not complete. """
+    def abort(self):
+        if self.file is None:
+            return
+        self.file.close()
+        self.file = None
+        try:
+            os.remove(self.temp_path)
+        except OSError:
+            pass
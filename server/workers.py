@@ -0,0 +1,276 @@
+import os
+import socket
+import logging
+import functools
+import collections
+import multiprocessing
+import concurrent.futures
+import concurrent.futures.process
+
+import request
+import upload
+import chunkstore
+from Crypto.Cipher import AES, PKCS1_OAEP
+from Crypto.PublicKey import RSA
+from Crypto.Util.Padding import unpad
+
+""" Worker pool class. The CPU heavy stages of the requests (RSA encryption of the symmetric keys, decryption,
+    decompression and CRC of the files and the chunks, assembling the files) run in worker processes, the event loop of
+    the server does only the I/O. Every worker is a process of its own with its own queue of jobs, so the jobs of one
+    upload run in their order on one worker (it keeps the state of the upload) while other uploads run on the other
+    workers. The results come back to the event loop: a job that completed wakes the loop through a socket pair and its
+    callback is called on the loop (see dispatch). """
+
+
+class WorkerPool:
+    WORKERS = os.cpu_count() or 1  # worker processes, one on every core
+
+    def __init__(self, workers=WORKERS):
+        # Workers are started by a fork server, they do not inherit the sockets and the database of the server.
+        self.context = multiprocessing.get_context('forkserver')
+        self.executors = [self.newExecutor() for _ in range(workers)]
+        self.load = [0] * workers  # jobs of every worker that did not complete yet
+        self.done = collections.deque()  # completed jobs, appended by the threads of the executors
+        self.wake_reader, self.wake_writer = socket.socketpair()
+        self.wake_reader.setblocking(False)
+        self.wake_writer.setblocking(False)
+        self.next_upload = 0
+
+    def newExecutor(self):
+        return concurrent.futures.ProcessPoolExecutor(1, mp_context=self.context)
+
+    """ The function starts the worker processes, so the first requests do not wait for them. """
+    def warm(self):
+        for executor in self.executors:
+            executor.submit(os.getpid).result()
+
+    """ The function returns the socket the event loop waits on for completed jobs. """
+    def fileno(self):
+        return self.wake_reader.fileno()
+
+    """ The function returns the worker with the least jobs. """
+    def worker(self):
+        return min(range(len(self.executors)), key=self.load.__getitem__)
+
+    """ The function returns a new ID for an upload, the workers keep the uploads by their IDs. """
+    def uploadId(self):
+        self.next_upload += 1
+        return self.next_upload
+
+    """ The function runs function(*args) on the worker. callback(result, error) is called on the event loop when the
+        job completed, error is the exception the job raised or None. """
+    def submit(self, worker, callback, function, *args):
+        self.load[worker] += 1
+        executor = self.executors[worker]
+        try:
+            future = executor.submit(function, *args)
+        except (RuntimeError, concurrent.futures.process.BrokenProcessPool) as e:  # worker died, failed right away
+            future = concurrent.futures.Future()
+            future.set_exception(e)
+        future.add_done_callback(lambda completed: self.completed(worker, executor, callback, completed))
+
+    """ The function is called by the thread of the executor when the job completed, it wakes the event loop. """
+    def completed(self, worker, executor, callback, future):
+        self.done.append((worker, executor, callback, future))
+        try:
+            self.wake_writer.send(b"\0")
+        except (BlockingIOError, InterruptedError):
+            pass  # the loop is woken already
+
+    """ The function calls the callbacks of the completed jobs, on the event loop. A worker that died is started again,
+        the jobs it had fail. """
+    def dispatch(self):
+        try:
+            while self.wake_reader.recv(4096):
+                pass
+        except (BlockingIOError, InterruptedError):
+            pass
+        while self.done:
+            worker, executor, callback, future = self.done.popleft()
+            self.load[worker] -= 1
+            try:
+                result, error = future.result(), None
+            except Exception as e:
+                result, error = None, e
+                if isinstance(e, concurrent.futures.process.BrokenProcessPool) and self.executors[worker] is executor:
+                    logging.error(f"Worker {worker} died, starting it again.")
+                    self.executors[worker] = self.newExecutor()
+                    executor.shutdown(wait=False)
+            if callback is not None:
+                callback(result, error)
+
+    """ The function stops the workers. """
+    def shutdown(self):
+        for executor in self.executors:
+            executor.shutdown(cancel_futures=True)
+
+
+""" Upload of send file request that runs on a worker. The connection receives the content into a batch buffer, every
+    full batch is sent to the worker of the upload, which decrypts, decompresses, checks by CRC and writes it (see
+    upload.FileUpload). Batches of an upload are processed in their order, uploads of other connections run on the
+    other workers. """
+
+
+class PooledUpload:
+    BATCH_SIZE = 1024 * 1024  # content sent to the worker at once
+    MAX_BATCHES = 4  # batches sent and not processed yet, the connection stops receiving beyond them
+
+    def __init__(self, pool, content_size, resume=None):
+        self.pool = pool
+        self.resume = resume  # called when the upload is not busy any more, the connection receives again
+        self.worker = pool.worker()
+        self.id = pool.uploadId()
+        self.remaining = content_size  # bytes of the content that did not arrive yet
+        self.content_size = content_size
+        self.buffer = bytearray(PooledUpload.BATCH_SIZE)
+        self.view = memoryview(self.buffer)
+        self.filled = 0
+        self.batches = 0  # batches on the worker
+        self.error = None  # reason the upload failed, the rest of the content is dropped
+        self.started = False  # the worker keeps the upload
+
+    """ The function starts the upload on its worker, see upload.FileUpload.start. """
+    def start(self, file_path, sym_key, code, compression=request.Compression.NONE.value, file_size=None):
+        self.started = True
+        self.batches += 1
+        self.pool.submit(self.worker, self.batchDone, startUpload, self.id, self.content_size, file_path, sym_key, code,
+                         compression, file_size)
+
+    """ The function fails the upload, the rest of its content is dropped and it fails when it finishes. """
+    def fail(self, reason):
+        if self.error is None:
+            self.error = str(reason)
+
+    """ The function checks if the worker has enough batches of the upload, the connection waits for them. """
+    def busy(self):
+        return self.batches >= PooledUpload.MAX_BATCHES
+
+    """ The function returns the part of the buffer the next bytes of the content are received into. """
+    def space(self):
+        return self.view[self.filled:min(len(self.buffer), self.filled + self.remaining)]
+
+    """ The function takes size bytes that were received into space(), a full batch is sent to the worker. """
+    def received(self, size):
+        self.filled += size
+        self.remaining -= size
+        if self.filled and (self.filled == len(self.buffer) or not self.remaining):
+            if self.error is None:
+                self.batches += 1
+                self.pool.submit(self.worker, self.batchDone, feedUpload, self.id, bytes(self.view[:self.filled]))
+            self.filled = 0
+
+    """ The function takes the bytes of the content that were received into another buffer, returns how many of them
+        belong to the content. """
+    def feed(self, data):
+        consumed = 0
+        with memoryview(data) as view:  # released before the caller removes the bytes
+            while self.remaining and consumed < len(view):
+                space = self.space()
+                size = min(len(space), len(view) - consumed)
+                space[:size] = view[consumed:consumed + size]
+                consumed += size
+                self.received(size)
+        return consumed
+
+    """ The function is called on the event loop when a batch of the upload was processed by the worker. A batch that 
+        failed (the worker died) fails the upload. The connection receives again once the upload is not busy. """
+    def batchDone(self, result, error):
+        was_busy = self.busy()
+        self.batches -= 1
+        if error is not None:
+            logging.error(f"Upload {self.id}: Batch failed on worker {self.worker}: {error}")
+            self.fail(error)
+        if was_busy and not self.busy() and self.resume is not None:
+            self.resume()
+
+    """ The function completes the upload on its worker once all the content arrived, callback(result, error) gets the
+        size and the CRC value of the file, see upload.FileUpload.finish. A batch that failed on the worker fails the
+        upload there. """
+    def finish(self, callback):
+        if self.error is not None:
+            self.abort()
+            self.pool.submit(self.worker, callback, failUpload, self.error)
+        else:
+            self.pool.submit(self.worker, callback, finishUpload, self.id)
+
+    """ The function drops the upload that did not complete. """
+    def abort(self):
+        if self.started:
+            self.started = False
+            self.pool.submit(self.worker, None, abortUpload, self.id)
+
+
+""" The functions below run in the worker processes. """
+
+uploads = {}  # uploads of the worker by their IDs
+
+
+""" The function returns the RSA key of the public key, the keys of the recent clients are parsed once. """
+@functools.lru_cache(maxsize=1024)
+def importKey(public_key):
+    return RSA.import_key(public_key)
+
+
+""" The function encrypts the symmetric key by the public key of the client. """
+def encryptKey(public_key, symmetric_key):
+    return PKCS1_OAEP.new(importKey(public_key)).encrypt(symmetric_key)
+
+
+""" The function starts the upload on the worker, an upload that can not start drops its content and fails when it
+    finishes. """
+def startUpload(upload_id, content_size, file_path, sym_key, code, compression, file_size):
+    file_upload = upload.FileUpload(content_size)
+    try:
+        file_upload.start(file_path, sym_key, code, compression, file_size)
+    except (ValueError, OSError) as e:
+        file_upload.fail(e)
+    uploads[upload_id] = file_upload
+
+
+def feedUpload(upload_id, data):
+    uploads[upload_id].feed(data)
+
+
+""" The function completes the upload, returns the size and the CRC value of the file or raises ValueError. """
+def finishUpload(upload_id):
+    file_upload = uploads.pop(upload_id, None)
+    if file_upload is None:
+        raise ValueError("Upload is not known to the worker")
+    return file_upload.finish()
+
+
+def failUpload(reason):
+    raise ValueError(reason)
+
+
+def abortUpload(upload_id):
+    file_upload = uploads.pop(upload_id, None)
+    if file_upload is not None:
+        file_upload.abort()
+
+
+""" The function decrypts content of a chunk with the AES key of the client, in the mode of the request code: AES-GCM
+    chunk, or AES-CBC. Raises ValueError if the content is not intact. """
+def decryptChunk(sym_key, content, code):
+    if code in (request.ClientRequestCode.REQUEST_SEND_CHUNK_GCM.value,
+                request.ClientRequestCode.REQUEST_SEND_COMPRESSED_CHUNK_GCM.value):
+        nonce = content[:request.GCM_NONCE_SIZE]
+        cipher = AES.new(sym_key, AES.MODE_GCM, nonce=nonce)
+        return cipher.decrypt_and_verify(content[request.GCM_NONCE_SIZE:-request.GCM_TAG_SIZE],
+                                         content[-request.GCM_TAG_SIZE:])
+
+    cipher = AES.new(sym_key, AES.MODE_CBC, iv=bytes(AES.block_size))  # IV used in the C++ code
+    return unpad(cipher.decrypt(content), AES.block_size)
+
+
+""" The function decrypts and decompresses the chunk and keeps it in the chunk store, returns its hash. Raises
+    ValueError if the chunk did not arrive intact. """
+def storeChunk(store_root, client_id, sym_key, code, compression, content):
+    content = decryptChunk(sym_key, content, code)
+    content = request.decompress(content, compression, request.MAX_CHUNK_SIZE)
+    return chunkstore.ChunkStore(store_root).put(client_id, content)
+
+
+""" The function assembles the file from the chunks of the chunk store, see chunkstore.ChunkStore.assemble. """
+def assembleFile(store_root, client_id, chunk_hashes, file_path):
+    return chunkstore.ChunkStore(store_root).assemble(client_id, chunk_hashes, file_path)